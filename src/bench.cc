@@ -0,0 +1,198 @@
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "include/bench.h"
+#include "include/bvh.h"
+#include "include/camera.h"
+#include "include/color.h"
+#include "include/hittable_list.h"
+#include "include/image.h"
+#include "include/material.h"
+#include "include/rt.h"
+#include "include/sampler.h"
+#include "include/scene.h"
+#include "include/sphere.h"
+
+namespace rt = raytracer;
+
+namespace {
+
+// rays of one batch, enough to defeat the branch predictor without leaving the l1 cache
+constexpr std::size_t kRays{1024};
+
+// rays from a shell of radius 4 around the origin towards points of the cube [-1, 1]^3, about
+// half of them hit a unit sphere at the origin
+std::vector<rt::ray> make_rays() {
+  std::vector<rt::ray> rays{};
+  rays.reserve(kRays);
+  for (std::size_t n = 0; n < kRays; n++) {
+    const auto origin = 4 * rt::sample_unit_vector();
+    const auto target = rt::vec3::random(-1, 1);
+    rays.emplace_back(origin, target - origin);
+  }
+  return rays;
+}
+
+// n spheres of radius 0.1 spread over the cube [-1, 1]^3
+rt::hittable_list make_spheres(const int n, const std::shared_ptr<rt::material>& mat) {
+  rt::hittable_list list{};
+  for (int i = 0; i < n; i++) {
+    list.add(std::make_shared<rt::sphere>(rt::vec3::random(-1, 1), 0.1, mat));
+  }
+  return list;
+}
+
+// hit records on s, one per ray that hits it
+std::vector<std::pair<rt::ray, rt::hit_record>> make_hits(const rt::sphere& s,
+                                                          const std::vector<rt::ray>& rays) {
+  std::vector<std::pair<rt::ray, rt::hit_record>> hits{};
+  for (const auto& r : rays) {
+    rt::hit_record rec{};
+    if (s.closest_hit(r, rt::interval{rt::kRayEpsilon, rt::infinite}, rec)) {
+      hits.emplace_back(r, rec);
+    }
+  }
+  return hits;
+}
+
+}  // namespace
+
+// usage: raytracer_bench [--filter name] [--repetitions n] [--warmup n] [--min-time seconds]
+//                        [--perf] [--json path]
+// times the hot kernels of a render in isolation and writes the results to bench.json, or to
+// the --json path. --perf adds hardware counters where perf_event_open is permitted
+int main(int argc, char* argv[]) {
+  rt::utility::bench_options opts{};
+  std::string json_path{"bench.json"};
+  for (int a = 1; a < argc; a++) {
+    const std::string_view arg{argv[a]};
+    const bool has_value = a + 1 < argc;
+    bool ok{true};
+    if (arg == "--perf") {
+      opts.perf_ = true;
+    } else if (arg == "--filter" && has_value) {
+      opts.filter_ = argv[++a];
+    } else if (arg == "--json" && has_value) {
+      json_path = argv[++a];
+    } else if (arg == "--repetitions" && has_value) {
+      ok = rt::parse_int(argv[++a], opts.repetitions_);
+    } else if (arg == "--warmup" && has_value) {
+      ok = rt::parse_int(argv[++a], opts.warmup_);
+    } else if (arg == "--min-time" && has_value) {
+      ok = rt::parse_double(argv[++a], opts.min_seconds_);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::println(stderr, "raytracer_bench: bad argument {}", arg);
+      return 1;
+    }
+  }
+
+  // every input comes from a fixed seed, so all runs time the same work
+  rt::thread_rng() = rt::pcg32{1, 0};
+  rt::thread_sampler() = rt::sampler{rt::sampler_kind::kIndependent, 1, 1};
+  rt::thread_sampler().start(0, 0);
+  const auto rays = make_rays();
+  rt::utility::bench bench{opts};
+
+  const auto grey = std::make_shared<rt::lambertian>(rt::color{0.5, 0.5, 0.5});
+  const rt::sphere unit{rt::point3{0, 0, 0}, 1, grey};
+  bench.run("sphere::hit", kRays, [&] {
+    for (const auto& r : rays) {
+      rt::hit_record rec{};
+      rt::utility::keep(unit.hit(r, rt::interval{rt::kRayEpsilon, rt::infinite}, rec));
+      rt::utility::keep(rec.t_);
+    }
+  });
+
+  for (const int n : {4, 16, 64, 256}) {
+    const auto list = make_spheres(n, grey);
+    bench.run(std::format("hittable_list::hit/{}", n), kRays, [&] {
+      for (const auto& r : rays) {
+        rt::hit_record rec{};
+        rt::utility::keep(list.hit(r, rt::interval{rt::kRayEpsilon, rt::infinite}, rec));
+        rt::utility::keep(rec.t_);
+      }
+    });
+    const rt::bvh_node bvh{list};
+    bench.run(std::format("bvh_node::hit/{}", n), kRays, [&] {
+      for (const auto& r : rays) {
+        rt::hit_record rec{};
+        rt::utility::keep(bvh.hit(r, rt::interval{rt::kRayEpsilon, rt::infinite}, rec));
+        rt::utility::keep(rec.t_);
+      }
+    });
+  }
+
+  // scatter off recorded hits, through the material table as the integrators call it
+  const std::vector<std::pair<std::string_view, std::shared_ptr<rt::material>>> materials{
+      {"lambertian", grey},
+      {"metal", std::make_shared<rt::metal>(rt::color{0.8, 0.8, 0.8}, 0.2)},
+      {"dielectric", std::make_shared<rt::dielectric>(1.5)}};
+  for (const auto& [name, mat] : materials) {
+    const rt::sphere s{rt::point3{0, 0, 0}, 1, mat};
+    const auto hits = make_hits(s, rays);
+    bench.run(std::format("material::scatter/{}", name), hits.size(), [&] {
+      for (const auto& [r, rec] : hits) {
+        rt::color attenuation{};
+        rt::ray scattered{};
+        rt::utility::keep(
+            rt::material_table::scatter(rec.material_id_, r, rec, attenuation, scattered));
+        rt::utility::keep(scattered);
+      }
+    });
+  }
+
+  bench.run("random_double", kRays, [] {
+    for (std::size_t n = 0; n < kRays; n++) {
+      rt::utility::keep(rt::random_double());
+    }
+  });
+  bench.run("sample_unit_vector", kRays, [] {
+    for (std::size_t n = 0; n < kRays; n++) {
+      rt::utility::keep(rt::sample_unit_vector());
+    }
+  });
+
+  // camera rays of one row, with defocus so the lens is sampled too
+  rt::options cam_opts{};
+  cam_opts.image_width_ = 1024;
+  cam_opts.defocus_angle_ = 0.6;
+  cam_opts.sampler_ = rt::sampler_kind::kSobol;
+  const rt::camera cam{cam_opts};
+  int sample{0};
+  bench.run("camera::primary_ray", static_cast<std::uint64_t>(cam_opts.image_width_), [&] {
+    for (int i = 0; i < cam_opts.image_width_; i++) {
+      rt::utility::keep(cam.primary_ray(i, 0, sample));
+    }
+    sample++;
+  });
+
+  // the gamma correction and quantization write2file applies to a 1600x900 image
+  constexpr int kWidth{1600};
+  constexpr int kHeight{900};
+  std::vector<rt::color> pixels(static_cast<std::size_t>(kWidth) * kHeight);
+  for (auto& p : pixels) {
+    p = rt::color::random(0, 1.2);
+  }
+  std::vector<char> encoded{};
+  bench.run("encode_rows/ppm", pixels.size(), [&] {
+    encoded.clear();
+    rt::encode_rows(rt::image_format::kPPMBinary, pixels, kWidth, encoded);
+    rt::utility::keep(encoded.data());
+  });
+
+  if (!bench.write_json(json_path)) {
+    std::println(stderr, "raytracer_bench: cannot write {}", json_path);
+    return 1;
+  }
+  std::println("results written to {}", json_path);
+  return 0;
+}
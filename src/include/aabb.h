@@ -0,0 +1,102 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <utility>
+
+#include "interval.h"
+#include "ray.h"
+
+namespace raytracer {
+
+// axis-aligned bounding box, stored as one interval per axis
+class aabb {
+ public:
+  // the default aabb is empty, since intervals are empty by default
+  constexpr aabb() = default;
+  constexpr aabb(const interval& x, const interval& y, const interval& z) : x_{x}, y_{y}, z_{z} {}
+
+  // treat the two points a and b as extrema for the bounding box
+  constexpr aabb(const point3& a, const point3& b)
+      : x_{a.x() <= b.x() ? interval{a.x(), b.x()} : interval{b.x(), a.x()}},
+        y_{a.y() <= b.y() ? interval{a.y(), b.y()} : interval{b.y(), a.y()}},
+        z_{a.z() <= b.z() ? interval{a.z(), b.z()} : interval{b.z(), a.z()}} {}
+
+  // tightest box enclosing both box0 and box1
+  constexpr aabb(const aabb& box0, const aabb& box1)
+      : x_{box0.x_, box1.x_}, y_{box0.y_, box1.y_}, z_{box0.z_, box1.z_} {}
+
+  [[nodiscard]] constexpr const interval& axis_interval(const int n) const {
+    if (n == 1) {
+      return y_;
+    }
+    if (n == 2) {
+      return z_;
+    }
+    return x_;
+  }
+
+  [[nodiscard]] constexpr bool empty() const {
+    return x_.size() < 0 || y_.size() < 0 || z_.size() < 0;
+  }
+
+  // index of the axis with the largest extent
+  [[nodiscard]] constexpr int longest_axis() const {
+    if (x_.size() > y_.size()) {
+      return x_.size() > z_.size() ? 0 : 2;
+    }
+    return y_.size() > z_.size() ? 1 : 2;
+  }
+
+  [[nodiscard]] constexpr point3 centroid() const {
+    return point3{(x_.min() + x_.max()) / 2, (y_.min() + y_.max()) / 2, (z_.min() + z_.max()) / 2};
+  }
+
+  // surface area, which is proportional to the probability of a random ray hitting the box
+  [[nodiscard]] constexpr real surface_area() const {
+    if (empty()) {
+      return 0;
+    }
+    const auto dx = x_.size();
+    const auto dy = y_.size();
+    const auto dz = z_.size();
+    return 2 * ((dx * dy) + (dy * dz) + (dz * dx));
+  }
+
+  [[nodiscard]] bool hit(const ray& r, const interval& ray_t) const {
+    const auto& dir = r.direction();
+    const vec3 inv_dir{1 / dir.x(), 1 / dir.y(), 1 / dir.z()};
+    return hit(r.origin(), inv_dir, ray_t);
+  }
+
+  // slab test with the reciprocal of the ray direction precomputed by the caller,
+  // which is what the bvh traversal uses since it tests one ray against many boxes
+  [[nodiscard]] bool hit(const point3& origin, const vec3& inv_dir, const interval& ray_t) const {
+    auto t_min = ray_t.min();
+    auto t_max = ray_t.max();
+    for (int axis = 0; axis < 3; axis++) {
+      const auto& ax = axis_interval(axis);
+      const auto ori = axis == 0 ? origin.x() : (axis == 1 ? origin.y() : origin.z());
+      const auto inv = axis == 0 ? inv_dir.x() : (axis == 1 ? inv_dir.y() : inv_dir.z());
+      auto t0 = (ax.min() - ori) * inv;
+      auto t1 = (ax.max() - ori) * inv;
+      if (inv < 0) {
+        std::swap(t0, t1);
+      }
+      t_min = t0 > t_min ? t0 : t_min;
+      t_max = t1 < t_max ? t1 : t_max;
+      if (t_max < t_min) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  interval x_{};
+  interval y_{};
+  interval z_{};
+};
+
+}  // namespace raytracer
+
+#endif
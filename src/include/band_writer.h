@@ -0,0 +1,155 @@
+#ifndef BAND_WRITER_H
+#define BAND_WRITER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "color.h"
+#include "image.h"
+
+namespace raytracer {
+
+// writes an image band by band from a background thread
+// bands are numbered in file order and may be submitted in any order, the writer keeps them
+// until every earlier band was written. at most max_inflight band buffers exist at a time,
+// acquire() blocks until the writer returns one
+class band_writer {
+ public:
+  band_writer(const std::string& path, const image_format format, const int width,
+              const int height, const int max_inflight)
+      : path_{path},
+        ofs_{path, std::ios::trunc | std::ios::binary},
+        format_{format},
+        width_{width},
+        max_inflight_{std::max(1, max_inflight)} {
+    const auto header = image_header(format, width, height);
+    ofs_.write(header.data(), std::ssize(header));
+    thread_ = std::jthread{[this] { run(); }};
+  }
+
+  band_writer(const band_writer&) = delete;
+  band_writer& operator=(const band_writer&) = delete;
+
+  ~band_writer() {
+    finish();
+  }
+
+  // a buffer for one band of `pixels` pixels
+  std::vector<color> acquire(const std::size_t pixels) {
+    std::unique_lock lock{mutex_};
+    cv_.wait(lock, [this] { return inflight_ < max_inflight_; });
+    inflight_++;
+    std::vector<color> band{};
+    if (!pool_.empty()) {
+      band = std::move(pool_.back());
+      pool_.pop_back();
+    }
+    band.resize(pixels);
+    return band;
+  }
+
+  void submit(const int index, std::vector<color> band) {
+    {
+      const std::scoped_lock lock{mutex_};
+      pending_.emplace(index, std::move(band));
+    }
+    cv_.notify_all();
+  }
+
+  // wait until every submitted band is on disk
+  void finish() {
+    {
+      const std::scoped_lock lock{mutex_};
+      if (done_) {
+        return;
+      }
+      done_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    ofs_.flush();
+  }
+
+  // stop without writing the bands still pending and remove the file, for a render that was
+  // cancelled before all of its bands were traced
+  void abandon() {
+    {
+      const std::scoped_lock lock{mutex_};
+      if (done_) {
+        return;
+      }
+      done_ = true;
+      abandoned_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    ofs_.close();
+    std::error_code ec{};
+    std::filesystem::remove(path_, ec);
+  }
+
+ private:
+  void run() {
+    std::vector<char> bytes{};
+    while (true) {
+      std::vector<color> band{};
+      {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return pending_.contains(next_) || done_; });
+        if (abandoned_) {
+          return;
+        }
+        const auto iter = pending_.find(next_);
+        if (iter == pending_.end()) {
+          // finished, and every band up to the first gap was written
+          return;
+        }
+        band = std::move(iter->second);
+        pending_.erase(iter);
+      }
+      bytes.clear();
+      encode_rows(format_, band, width_, bytes);
+      ofs_.write(bytes.data(), std::ssize(bytes));
+      {
+        const std::scoped_lock lock{mutex_};
+        next_++;
+        inflight_--;
+        pool_.push_back(std::move(band));
+      }
+      cv_.notify_all();
+    }
+  }
+
+  std::string path_;
+  std::ofstream ofs_;
+  image_format format_;
+  int width_;
+  int max_inflight_;
+
+  std::mutex mutex_{};
+  std::condition_variable cv_{};
+  std::map<int, std::vector<color>> pending_{};
+  std::vector<std::vector<color>> pool_{};
+  int next_{0};
+  int inflight_{0};
+  bool done_{false};
+  bool abandoned_{false};
+  std::jthread thread_{};
+};
+
+}  // namespace raytracer
+
+#endif
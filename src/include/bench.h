@@ -0,0 +1,279 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "rt.h"
+#include "simd.h"
+
+namespace raytracer::utility {
+
+// keep the compiler from dropping a computation whose result is otherwise unused
+template <typename T>
+inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// hardware counters of the calling thread, read around every repetition of a benchmark
+// opened as one group so all counters cover the same instructions. containers and vms often
+// deny perf_event_open, in which case available() is false and nothing is counted
+class perf_counters {
+ public:
+  static constexpr std::array<std::string_view, 4> kNames{"cycles", "instructions",
+                                                          "branch_misses", "cache_misses"};
+  using values = std::array<std::uint64_t, kNames.size()>;
+
+  perf_counters() {
+    static constexpr std::array<std::uint64_t, kNames.size()> kConfigs{
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES};
+    for (std::size_t c = 0; c < kNames.size(); c++) {
+      perf_event_attr attr{};
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = kConfigs[c];
+      attr.disabled = leader_ < 0 ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      const auto fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+      if (fd < 0) {
+        if (leader_ < 0) {
+          return;
+        }
+        continue;
+      }
+      if (leader_ < 0) {
+        leader_ = fd;
+      }
+      fds_.push_back(fd);
+      slots_.push_back(c);
+    }
+  }
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  ~perf_counters() {
+    for (const auto fd : fds_) {
+      ::close(fd);
+    }
+  }
+
+  [[nodiscard]] bool available() const {
+    return leader_ >= 0;
+  }
+
+  // counter is measured, some cpus lack a counter the others have
+  [[nodiscard]] bool has(const std::size_t counter) const {
+    return std::ranges::find(slots_, counter) != slots_.end();
+  }
+
+  void start() const {
+    if (available()) {
+      ::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+
+  // counts since start()
+  [[nodiscard]] values stop() const {
+    values out{};
+    if (!available()) {
+      return out;
+    }
+    ::ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // group read: the number of counters, then one value per counter in the order opened
+    std::array<std::uint64_t, kNames.size() + 1> buf{};
+    if (::read(leader_, buf.data(), sizeof(buf)) > 0) {
+      for (std::size_t i = 0; i < slots_.size() && i < buf[0]; i++) {
+        out[slots_[i]] = buf[i + 1];
+      }
+    }
+    return out;
+  }
+
+ private:
+  int leader_{-1};
+  std::vector<int> fds_{};
+  std::vector<std::size_t> slots_{};  // counter index of every opened fd
+};
+
+struct bench_options {
+  int warmup_{3};             // NOLINT untimed repetitions before measuring
+  int repetitions_{15};       // NOLINT timed repetitions, the statistics are over these
+  double min_seconds_{0.02};  // NOLINT each repetition calls the body until it runs this long
+  bool perf_{false};          // NOLINT read hardware counters around every repetition
+  std::string filter_{};      // NOLINT only run benchmarks whose name contains this
+};
+
+// timings of one benchmark, in nanoseconds per operation
+struct bench_result {
+  std::string name_{};                                            // NOLINT
+  std::uint64_t ops_{};                                           // NOLINT per repetition
+  double median_{};                                               // NOLINT
+  double p10_{};                                                  // NOLINT
+  double p90_{};                                                  // NOLINT
+  double min_{};                                                  // NOLINT
+  double max_{};                                                  // NOLINT
+  std::array<double, perf_counters::kNames.size()> counters_{};   // NOLINT per operation
+  std::array<bool, perf_counters::kNames.size()> has_counter_{};  // NOLINT
+};
+
+// runs and records micro-benchmarks
+// a body performs a known number of operations per call. warmup calls also size the batch, the
+// number of calls that make one repetition last min_seconds_, so timer resolution and call
+// overhead stay small against the measured work. results are reported as the median and
+// percentiles over the repetitions, which are robust against the odd interrupted repetition
+class bench {
+ public:
+  explicit bench(bench_options opts) : opts_{std::move(opts)} {
+    if (opts_.perf_) {
+      perf_.emplace();
+      if (!perf_->available()) {
+        std::println(stderr, "[bench]: hardware counters are not available, timing only.");
+        perf_.reset();
+      }
+    }
+  }
+
+  // time body, which performs `ops` operations per call
+  template <typename Body>
+  void run(const std::string_view name, const std::uint64_t ops, Body&& body) {
+    if (!opts_.filter_.empty() && name.find(opts_.filter_) == std::string_view::npos) {
+      return;
+    }
+    using clock = std::chrono::steady_clock;
+    const auto seconds = [](const clock::time_point start) {
+      return std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    // double the batch until one repetition is long enough, then run the remaining warmups
+    std::uint64_t batch{1};
+    while (true) {
+      const auto start = clock::now();
+      for (std::uint64_t b = 0; b < batch; b++) {
+        body();
+      }
+      if (seconds(start) >= opts_.min_seconds_ || batch >= (std::uint64_t{1} << 40U)) {
+        break;
+      }
+      batch *= 2;
+    }
+    for (int w = 1; w < opts_.warmup_; w++) {
+      for (std::uint64_t b = 0; b < batch; b++) {
+        body();
+      }
+    }
+
+    const auto reps = std::max(1, opts_.repetitions_);
+    const auto ops_per_rep = static_cast<double>(batch * ops);
+    std::vector<double> ns(reps);
+    perf_counters::values counted{};
+    for (int rep = 0; rep < reps; rep++) {
+      if (perf_) {
+        perf_->start();
+      }
+      const auto start = clock::now();
+      for (std::uint64_t b = 0; b < batch; b++) {
+        body();
+      }
+      ns[rep] = seconds(start) * 1e9 / ops_per_rep;
+      if (perf_) {
+        const auto values = perf_->stop();
+        for (std::size_t c = 0; c < counted.size(); c++) {
+          counted[c] += values[c];
+        }
+      }
+    }
+
+    std::ranges::sort(ns);
+    const auto percentile = [&](const double q) {
+      const auto pos = q * static_cast<double>(reps - 1);
+      const auto lo = static_cast<std::size_t>(pos);
+      const auto hi = std::min(lo + 1, ns.size() - 1);
+      return ns[lo] + ((pos - static_cast<double>(lo)) * (ns[hi] - ns[lo]));
+    };
+    bench_result result{.name_ = std::string{name},
+                        .ops_ = batch * ops,
+                        .median_ = percentile(0.5),
+                        .p10_ = percentile(0.1),
+                        .p90_ = percentile(0.9),
+                        .min_ = ns.front(),
+                        .max_ = ns.back()};
+    if (perf_) {
+      for (std::size_t c = 0; c < counted.size(); c++) {
+        result.has_counter_[c] = perf_->has(c);
+        result.counters_[c] = static_cast<double>(counted[c]) / (ops_per_rep * reps);
+      }
+    }
+    print(result);
+    results_.push_back(std::move(result));
+  }
+
+  [[nodiscard]] const std::vector<bench_result>& results() const {
+    return results_;
+  }
+
+  // every result with the build configuration, so runs of different commits can be compared
+  bool write_json(const std::string& path) const {
+    std::string out = std::format(
+        "{{\n  \"real_bytes\": {},\n  \"simd_width\": {},\n  \"repetitions\": {},\n"
+        "  \"perf_counters\": {},\n  \"results\": [",
+        sizeof(real), simd::kWidth, opts_.repetitions_, perf_.has_value());
+    for (std::size_t i = 0; i < results_.size(); i++) {
+      const auto& r = results_[i];
+      out += std::format(
+          "{}\n    {{\"name\": \"{}\", \"ops\": {}, \"median_ns\": {:.4f}, \"p10_ns\": {:.4f}, "
+          "\"p90_ns\": {:.4f}, \"min_ns\": {:.4f}, \"max_ns\": {:.4f}",
+          i == 0 ? "" : ",", r.name_, r.ops_, r.median_, r.p10_, r.p90_, r.min_, r.max_);
+      for (std::size_t c = 0; c < r.counters_.size(); c++) {
+        if (r.has_counter_[c]) {
+          out += std::format(", \"{}_per_op\": {:.4f}", perf_counters::kNames[c], r.counters_[c]);
+        }
+      }
+      out += "}";
+    }
+    out += "\n  ]\n}\n";
+    std::ofstream ofs(path, std::ios::trunc);
+    ofs << out;
+    return static_cast<bool>(ofs);
+  }
+
+ private:
+  static void print(const bench_result& r) {
+    auto line = std::format("{:<36} {:>10.3f} ns/op  [p10 {:.3f}, p90 {:.3f}]", r.name_,
+                            r.median_, r.p10_, r.p90_);
+    for (std::size_t c = 0; c < r.counters_.size(); c++) {
+      if (r.has_counter_[c]) {
+        line += std::format("  {} {:.2f}", perf_counters::kNames[c], r.counters_[c]);
+      }
+    }
+    std::println("{}", line);
+  }
+
+  bench_options opts_;
+  std::optional<perf_counters> perf_{};
+  std::vector<bench_result> results_{};
+};
+
+}  // namespace raytracer::utility
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <vector>
+
+#include "aabb.h"
+#include "bvh_tree.h"
+#include "dispatch.h"
+#include "hash.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "lbvh.h"
+#include "metrics.h"
+#include "simd.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "timer.h"
+
+namespace raytracer {
+
+enum class bvh_build_method : std::uint8_t {
+  kSAH,     // binned surface area heuristic, serial top-down
+  kMorton,  // linear bvh from sorted morton codes, parallel bottom-up
+};
+
+struct bvh_options {
+  bvh_build_method method_{bvh_build_method::kSAH};  // NOLINT
+  int max_leaf_size_{4};                             // NOLINT
+  int morton_bits_{30};                              // NOLINT kMorton only, 30 or 63
+  int treelet_passes_{0};                            // NOLINT kMorton only, 0 skips treelets
+};
+
+// bounding volume hierarchy over the objects of a hittable_list
+class bvh_node : public hittable {
+ public:
+  explicit bvh_node(const hittable_list& list, const bvh_options& opts = {}) {
+    utility::timer timer{};
+    const utility::phase_timer phase{"bvh build"};
+    const auto& objects = list.objects();
+    std::vector<aabb> bounds(objects.size());
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::size_t i = 0; i < objects.size(); i++) {
+      bounds[i] = objects[i]->bounding_box();
+    }
+    // scenes made only of spheres keep them in a sphere_set, whose leaves are tested
+    // simd::kWidth spheres at a time, so leaves may grow up to that width
+    const auto all_spheres = !objects.empty() && std::ranges::all_of(objects, [](const auto& obj) {
+      return dynamic_cast<const sphere*>(obj.get()) != nullptr;
+    });
+    const auto leaf_batch = all_spheres ? simd::kWidth : 1;
+    const auto max_leaf_size = std::max(opts.max_leaf_size_, leaf_batch);
+
+    std::vector<std::uint32_t> order{};
+    if (opts.method_ == bvh_build_method::kMorton) {
+      const lbvh_builder::settings settings{.morton_bits_ = opts.morton_bits_,
+                                            .treelet_passes_ = opts.treelet_passes_,
+                                            .max_leaf_size_ = max_leaf_size,
+                                            .leaf_batch_ = leaf_batch};
+      tree_ = lbvh_builder::build(bounds, settings, order);
+    } else {
+      tree_ = bvh_tree::build_sah(bounds, max_leaf_size, order, leaf_batch);
+    }
+    // store objects in leaf order, so every leaf covers a contiguous range
+    if (all_spheres) {
+      for (const auto idx : order) {
+        spheres_.add(static_cast<const sphere&>(*objects[idx]));
+      }
+    } else {
+      objects_.reserve(objects.size());
+      kinds_.reserve(objects.size());
+      for (const auto idx : order) {
+        objects_.push_back(objects[idx]);
+        kinds_.push_back(primitive_kind_of(*objects[idx]));
+      }
+    }
+    timer.report(std::format("[bvh]: {} build of {} objects into {} nodes done.",
+                             opts.method_ == bvh_build_method::kMorton ? "morton" : "sah",
+                             objects.size(), tree_.nodes().size()));
+  }
+
+  bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
+    if (spheres_.size() > 0) {
+      const auto spheres = spheres_.view();
+      return tree_.hit(r, ray_t, [&](const std::uint32_t first, const std::uint32_t count,
+                                     real& closest) {
+        if (spheres.hit(r, interval{ray_t.min(), closest}, first, count, rec)) {
+          closest = rec.t_;
+          return true;
+        }
+        return false;
+      });
+    }
+    return tree_.hit(r, ray_t,
+                     [&](const std::uint32_t first, const std::uint32_t count, real& closest) {
+                       bool hit_anything{false};
+                       for (auto i = first; i < first + count; i++) {
+                         // objects only write to rec when they report a hit
+                         if (dispatch_hit(kinds_[i], *objects_[i], r,
+                                          interval{ray_t.min(), closest}, rec)) {
+                           hit_anything = true;
+                           closest = rec.t_;
+                         }
+                       }
+                       return hit_anything;
+                     });
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return tree_.bounding_box();
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    if (spheres_.size() > 0) {
+      return spheres_.hash();
+    }
+    hasher h{};
+    for (const auto& obj : objects_) {
+      const auto child = obj->hash();
+      if (child == kUnhashed) {
+        return kUnhashed;
+      }
+      h.add(child);
+    }
+    return h.value();
+  }
+
+ private:
+  bvh_tree tree_{};
+  std::vector<std::shared_ptr<hittable>> objects_{};
+  std::vector<primitive_kind> kinds_{};
+  sphere_set spheres_{};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,335 @@
+#ifndef BVH_TREE_H
+#define BVH_TREE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "aabb.h"
+#include "metrics.h"
+
+namespace raytracer {
+
+// node of a flattened bounding volume hierarchy
+// the two children of an interior node are always stored next to each other, so one offset
+// is enough to address both of them
+struct bvh_flat_node {
+  aabb box_{};              // NOLINT
+  std::uint32_t offset_{};  // NOLINT leaf: first primitive, interior: left child (right is +1)
+  std::uint16_t count_{};   // NOLINT number of primitives in a leaf, 0 for interior nodes
+  std::uint8_t axis_{};     // NOLINT split axis, used to visit the nearer child first
+};
+
+// flattened bvh over an abstract set of primitives
+// the tree only knows primitive bounds, callers keep the primitives themselves in leaf order
+class bvh_tree {
+ public:
+  static constexpr int kBins{16};
+  // depth the traversal stack holds without allocating, see traverse()
+  static constexpr int kMaxDepth{64};
+  // from this depth on the sah builder splits at the median, which ends every subtree within
+  // 32 more levels, so its trees never outgrow the traversal stack
+  static constexpr int kMedianDepth{kMaxDepth - 32};
+  // bvh_flat_node::count_ holds no more
+  static constexpr int kMaxLeafSize{std::numeric_limits<std::uint16_t>::max()};
+  // relative cost of visiting an interior node against intersecting one primitive
+  static constexpr double kTraversalCost{0.125};
+
+  bvh_tree() = default;
+  explicit bvh_tree(std::vector<bvh_flat_node> nodes) : nodes_{std::move(nodes)} {}
+
+  // binned surface area heuristic build
+  // `order` receives the permutation mapping leaf slots to indices of `bounds`
+  // `leaf_batch` primitives of a leaf are intersected at the cost of one, as simd leaves do
+  static bvh_tree build_sah(std::span<const aabb> bounds, const int max_leaf_size,
+                            std::vector<std::uint32_t>& order, const int leaf_batch = 1) {
+    bvh_tree tree{};
+    order.resize(bounds.size());
+    for (std::uint32_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    if (bounds.empty()) {
+      return tree;
+    }
+    std::vector<point3> centroids(bounds.size());
+    for (std::size_t i = 0; i < bounds.size(); i++) {
+      centroids[i] = bounds[i].centroid();
+    }
+    tree.nodes_.reserve(2 * bounds.size());
+    tree.nodes_.emplace_back();
+    sah_builder builder{bounds, centroids, order, tree.nodes_,
+                        std::clamp(max_leaf_size, 1, kMaxLeafSize), std::max(1, leaf_batch)};
+    builder.build(0, 0, static_cast<std::uint32_t>(bounds.size()), 0);
+    tree.nodes_.shrink_to_fit();
+    return tree;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return nodes_.empty();
+  }
+  [[nodiscard]] const std::vector<bvh_flat_node>& nodes() const {
+    return nodes_;
+  }
+  [[nodiscard]] aabb bounding_box() const {
+    return nodes_.empty() ? aabb{} : nodes_.front().box_;
+  }
+
+  // recompute every box for primitives that moved, keeping the topology
+  // `bounds` holds the new primitive bounds in leaf order. both builders store children after
+  // their parent, so one pass from the back sees every child before its parent
+  void refit(std::span<const aabb> bounds) {
+    for (auto n = nodes_.size(); n-- > 0;) {
+      auto& node = nodes_[n];
+      if (node.count_ > 0) {
+        aabb box{};
+        for (auto i = node.offset_; i < node.offset_ + node.count_; i++) {
+          box = aabb{box, bounds[i]};
+        }
+        node.box_ = box;
+      } else {
+        node.box_ = aabb{nodes_[node.offset_].box_, nodes_[node.offset_ + 1].box_};
+      }
+    }
+  }
+
+  // expected cost of a ray through the tree under the surface area heuristic, in units of one
+  // primitive test. refits let it grow as primitives move apart from their leaf neighbours
+  [[nodiscard]] double sah_cost() const {
+    if (nodes_.empty() || nodes_.front().box_.surface_area() <= 0) {
+      return 0;
+    }
+    double cost{0};
+    for (const auto& node : nodes_) {
+      const auto area = static_cast<double>(node.box_.surface_area());
+      cost += area * (node.count_ > 0 ? static_cast<double>(node.count_) : kTraversalCost);
+    }
+    return cost / nodes_.front().box_.surface_area();
+  }
+
+  // visit leaves front to back along the ray
+  // `leaf_hit(first, count, closest)` intersects the primitives of one leaf, shrinks `closest`
+  // when it finds a nearer hit, and returns whether it found one
+  template <typename LeafHit>
+  bool hit(const ray& r, const interval& ray_t, LeafHit&& leaf_hit) const {
+    return traverse(nodes_, r, ray_t, std::forward<LeafHit>(leaf_hit));
+  }
+
+  // hit() over nodes stored elsewhere, such as a memory-mapped scene file
+  template <typename LeafHit>
+  static bool traverse(std::span<const bvh_flat_node> nodes, const ray& r, const interval& ray_t,
+                       LeafHit&& leaf_hit) {
+    if (nodes.empty()) {
+      return false;
+    }
+    const auto& dir = r.direction();
+    const vec3 inv_dir{1 / dir.x(), 1 / dir.y(), 1 / dir.z()};
+    const std::array<bool, 3> dir_is_neg{inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0};
+
+    // trees from the sah builder fit the fixed stack, deeper ones (lbvh trees over long runs of
+    // nearly equal morton codes, or nodes read from a file) spill the rest into overflow
+    std::array<std::uint32_t, kMaxDepth> stack{};
+    int stack_size{0};
+    std::vector<std::uint32_t> overflow{};
+    const auto push = [&](const std::uint32_t n) {
+      if (stack_size < kMaxDepth) {
+        stack[stack_size++] = n;
+      } else {
+        overflow.push_back(n);
+      }
+    };
+    std::uint32_t current{0};
+    auto closest = ray_t.max();
+    bool hit_anything{false};
+    std::uint64_t box_tests{0};
+    while (true) {
+      const auto& node = nodes[current];
+      box_tests++;
+      if (node.box_.hit(r.origin(), inv_dir, interval{ray_t.min(), closest})) {
+        if (node.count_ > 0) {
+          if (leaf_hit(node.offset_, static_cast<std::uint32_t>(node.count_), closest)) {
+            hit_anything = true;
+          }
+        } else {
+          // descend into the child on the near side of the split plane first, so the far child
+          // is often culled by the shrunken interval
+          if (dir_is_neg[node.axis_]) {
+            push(node.offset_);
+            current = node.offset_ + 1;
+          } else {
+            push(node.offset_ + 1);
+            current = node.offset_;
+          }
+          continue;
+        }
+      }
+      // overflow only fills while the stack is full, so it holds the latest entries
+      if (!overflow.empty()) {
+        current = overflow.back();
+        overflow.pop_back();
+        continue;
+      }
+      if (stack_size == 0) {
+        break;
+      }
+      current = stack[--stack_size];
+    }
+    utility::metrics::count_box_tests(box_tests);
+    return hit_anything;
+  }
+
+ private:
+  struct bin {
+    aabb box_{};             // NOLINT
+    std::uint32_t count_{};  // NOLINT
+  };
+
+  struct sah_builder {
+    std::span<const aabb> bounds_;       // NOLINT
+    std::span<const point3> centroids_;  // NOLINT
+    std::vector<std::uint32_t>& order_;  // NOLINT
+    std::vector<bvh_flat_node>& nodes_;  // NOLINT
+    int max_leaf_size_;                  // NOLINT
+    int leaf_batch_;                     // NOLINT
+
+    // cost of intersecting `count` primitives, in units of one primitive test
+    [[nodiscard]] double batches(const std::uint32_t count) const {
+      return static_cast<double>((count + leaf_batch_ - 1) / leaf_batch_);
+    }
+
+    [[nodiscard]] static double axis_of(const point3& p, const int axis) {
+      return axis == 0 ? p.x() : (axis == 1 ? p.y() : p.z());
+    }
+
+    void make_leaf(const std::uint32_t node, const std::uint32_t begin, const std::uint32_t end) {
+      nodes_[node].offset_ = begin;
+      nodes_[node].count_ = static_cast<std::uint16_t>(end - begin);
+    }
+
+    void build(const std::uint32_t node, const std::uint32_t begin, const std::uint32_t end,
+               const int depth) {
+      aabb box{};
+      aabb centroid_box{};
+      for (auto i = begin; i < end; i++) {
+        box = aabb{box, bounds_[order_[i]]};
+        const auto& c = centroids_[order_[i]];
+        centroid_box = aabb{centroid_box, aabb{c, c}};
+      }
+      nodes_[node].box_ = box;
+
+      const auto count = end - begin;
+      if (count == 1) {
+        make_leaf(node, begin, end);
+        return;
+      }
+      if (depth >= kMedianDepth) {
+        if (count <= static_cast<std::uint32_t>(max_leaf_size_)) {
+          make_leaf(node, begin, end);
+          return;
+        }
+        const auto axis = centroid_box.longest_axis();
+        const auto mid = begin + (count / 2);
+        std::nth_element(order_.data() + begin, order_.data() + mid, order_.data() + end,
+                         [&](const std::uint32_t a, const std::uint32_t b) {
+                           return axis_of(centroids_[a], axis) < axis_of(centroids_[b], axis);
+                         });
+        split(node, axis, begin, mid, end, depth);
+        return;
+      }
+
+      // evaluate every bin boundary along every axis
+      auto best_cost{infinite};
+      int best_axis{-1};
+      int best_split{0};
+      for (int axis = 0; axis < 3; axis++) {
+        const auto& extent = centroid_box.axis_interval(axis);
+        if (extent.size() <= 0) {
+          continue;
+        }
+        std::array<bin, kBins> bins{};
+        const auto scale = kBins / extent.size();
+        for (auto i = begin; i < end; i++) {
+          const auto idx = bin_index(order_[i], axis, extent.min(), scale);
+          bins[idx].count_++;
+          bins[idx].box_ = aabb{bins[idx].box_, bounds_[order_[i]]};
+        }
+        // sweep from the right to collect the cost of the right partition of every split
+        std::array<double, kBins - 1> right_cost{};
+        aabb right_box{};
+        std::uint32_t right_count{0};
+        for (int i = kBins - 1; i > 0; i--) {
+          right_box = aabb{right_box, bins[i].box_};
+          right_count += bins[i].count_;
+          right_cost[i - 1] = batches(right_count) * right_box.surface_area();
+        }
+        aabb left_box{};
+        std::uint32_t left_count{0};
+        for (int i = 0; i < kBins - 1; i++) {
+          left_box = aabb{left_box, bins[i].box_};
+          left_count += bins[i].count_;
+          const auto cost = (batches(left_count) * left_box.surface_area()) + right_cost[i];
+          if (left_count > 0 && left_count < count && cost < best_cost) {
+            best_cost = cost;
+            best_axis = axis;
+            best_split = i;
+          }
+        }
+      }
+
+      std::uint32_t mid{};
+      if (best_axis < 0) {
+        // all centroids coincide, so no plane separates them
+        if (count <= static_cast<std::uint32_t>(max_leaf_size_)) {
+          make_leaf(node, begin, end);
+          return;
+        }
+        best_axis = box.longest_axis();
+        mid = begin + (count / 2);
+      } else {
+        const auto area = box.surface_area();
+        const auto split_cost =
+            kTraversalCost + (area > 0 ? best_cost / area : batches(count));
+        if (count <= static_cast<std::uint32_t>(max_leaf_size_) && batches(count) <= split_cost) {
+          make_leaf(node, begin, end);
+          return;
+        }
+        const auto& extent = centroid_box.axis_interval(best_axis);
+        const auto scale = kBins / extent.size();
+        const auto* split =
+            std::partition(order_.data() + begin, order_.data() + end, [&](std::uint32_t prim) {
+              return bin_index(prim, best_axis, extent.min(), scale) <= best_split;
+            });
+        mid = static_cast<std::uint32_t>(split - order_.data());
+      }
+
+      split(node, best_axis, begin, mid, end, depth);
+    }
+
+    // make node interior over children [begin, mid) and [mid, end) and build them
+    void split(const std::uint32_t node, const int axis, const std::uint32_t begin,
+               const std::uint32_t mid, const std::uint32_t end, const int depth) {
+      const auto left = static_cast<std::uint32_t>(nodes_.size());
+      nodes_.emplace_back();
+      nodes_.emplace_back();
+      nodes_[node].offset_ = left;
+      nodes_[node].axis_ = static_cast<std::uint8_t>(axis);
+      build(left, begin, mid, depth + 1);
+      build(left + 1, mid, end, depth + 1);
+    }
+
+    [[nodiscard]] int bin_index(const std::uint32_t prim, const int axis, const double min,
+                                const double scale) const {
+      const auto idx = static_cast<int>((axis_of(centroids_[prim], axis) - min) * scale);
+      return std::clamp(idx, 0, kBins - 1);
+    }
+  };
+
+  std::vector<bvh_flat_node> nodes_{};
+};
+
+}  // namespace raytracer
+
+#endif
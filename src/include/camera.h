@@ -1,13 +1,38 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 
+#include "band_writer.h"
 #include "color.h"
+#include "denoise.h"
+#include "film.h"
+#include "hash.h"
 #include "hittable.h"
+#include "image.h"
 #include "material.h"
+#include "metrics.h"
+#include "roulette.h"
+#include "sampler.h"
+#include "scheduler.h"
 #include "timer.h"
 #include "vec3.h"
+#include "wavefront.h"
 
 namespace raytracer {
 
@@ -15,18 +40,65 @@ using utility::timer;
 
 class camera;
 
+// how radiance along camera rays is estimated
+enum class integrator : std::uint8_t {
+  kRecursive,  // one path at a time, recursing at every bounce
+  kWavefront,  // waves of paths advanced bounce by bounce, see wavefront.h
+};
+
 class options {
  public:
   double aspect_ratio_{16.0 / 9.0};
   int image_width_{1600};
   int samples_per_pixel_{10};
-  int max_depth_{10};
+  int max_depth_{10};               // safety cap on path segments
+  int roulette_depth_{3};           // segments before russian roulette, >= max_depth_ disables it
   double vfov_{90};                 // field of view(vertical view angle)
   point3 lookfrom_{vec3{0, 0, 0}};  // point camera is looking from
   point3 lookat_{vec3{0, 0, -1}};   // point camera is looking at
   vec3 vup_{vec3{0, 1, 0}};         // camera-relative up direction
   double defocus_angle_{0};         // Variation angle of rays through each pixel
   double focus_dis_{10};            // Distance from camera lookfrom point to plane of perfect focus
+  std::uint64_t seed_{0};  // renders with equal seeds and settings give identical images
+  sampler_kind sampler_{sampler_kind::kSobol};
+  integrator integrator_{integrator::kRecursive};
+  std::size_t wavefront_size_{1 << 18};  // paths in flight per wave of the wavefront integrator
+  int tile_size_{32};                    // edge length of the square tiles the image is split into
+  int threads_{0};                       // render threads, 0 uses every hardware thread
+  image_format output_format_{image_format::kPPMBinary};
+  std::string output_path_{};  // empty picks output.ppm or output.pfm from the format
+  bool streaming_{false};      // render in bands written by a background thread
+  int band_height_{16};        // rows per band when streaming
+  int max_inflight_bands_{3};  // bands rendered or waiting for the writer, caps memory use
+  std::string checkpoint_path_{};  // accumulation file to resume from and save to, empty disables
+  int checkpoint_interval_{60};    // seconds between checkpoint saves
+  // adaptive sampling: every pixel takes samples in batches until the standard error of its
+  // mean luminance drops below adaptive_error_ times the mean, within the sample range below
+  bool adaptive_{false};
+  int adaptive_min_samples_{16};
+  int adaptive_max_samples_{1024};
+  int adaptive_batch_{8};          // samples between convergence checks
+  double adaptive_error_{0.02};    // target relative standard error
+  std::string sample_map_path_{};  // empty picks output.samples.<ext>, written in adaptive mode
+  // denoising: the first hit of every camera ray goes into albedo, normal and depth buffers,
+  // which guide an edge-avoiding filter over the finished frame, see denoise.h. only whole-frame
+  // renders are denoised, streaming, checkpointed and partial renders are not
+  bool denoise_{false};
+  int denoise_iterations_{5};
+  double denoise_color_sigma_{0.5};
+  double denoise_normal_sigma_{0.1};
+  double denoise_depth_sigma_{0.05};
+  bool write_aovs_{false};  // write the buffers as <image stem>.{albedo,normal,depth}.<ext>
+  // partial render, to spread one frame over several processes: only the tiles
+  // [tile_begin_, tile_end_) of the frame and the samples [sample_begin_, sample_end_) of their
+  // pixels are traced, into a film saved to partial_path_ instead of an image. partials of one
+  // frame add up to the full render, see raytracer_merge. negative ends run to the last tile or
+  // to samples_per_pixel_
+  std::string partial_path_{};  // empty renders the whole frame
+  int tile_begin_{0};
+  int tile_end_{-1};
+  int sample_begin_{0};
+  int sample_end_{-1};
 
  private:
   friend camera;
@@ -56,19 +128,104 @@ class options {
 class camera {
  public:
   camera() = default;
-  explicit camera(const options& opts) : opts_{opts} {}
+  explicit camera(const options& opts) : opts_{opts} {
+    initialize();
+  }
 
   void render(const hittable& world) {
     initialize();
-    timer_.report("[render]: calculating pixels...");
-    auto pixels_buf = calculate_pixels(world);
-    timer_.report("[render]: calculating pixels done.");
-    timer_.report("[render]: writing to file...");
-    write2file(pixels_buf);
-    timer_.report("[render]: writing to file done.");
+    const timer render_timer{};
+    render_start_ = std::chrono::steady_clock::now();
+    first_tile_seconds_ = -1;
+    if (!opts_.partial_path_.empty()) {
+      timer_.report("[render]: calculating partial film...");
+      render_partial(world);
+      timer_.report("[render]: calculating partial film done.");
+    } else if (!opts_.checkpoint_path_.empty()) {
+      timer_.report("[render]: calculating pixels with checkpoints...");
+      render_checkpointed(world);
+      timer_.report("[render]: calculating pixels with checkpoints done.");
+    } else if (opts_.streaming_) {
+      timer_.report("[render]: streaming bands to file...");
+      render_streaming(world);
+      timer_.report("[render]: streaming bands to file done.");
+    } else {
+      timer_.report("[render]: calculating pixels...");
+      auto pixels_buf = calculate_pixels(world);
+      timer_.report("[render]: calculating pixels done.");
+      timer_.report("[render]: writing to file...");
+      write2file(pixels_buf);
+      if (opts_.write_aovs_) {
+        write_aovs();
+      }
+      timer_.report("[render]: writing to file done.");
+    }
+    if (opts_.adaptive_ && opts_.checkpoint_path_.empty() && opts_.partial_path_.empty()) {
+      write_sample_map();
+    }
+    timer_.report(std::format("[render]: {} paths, {:.2f} segments per path on average.",
+                              stats_.paths_, stats_.average_length()));
+    if constexpr (utility::metrics::kEnabled) {
+      write_metrics(render_timer.elapsedFromStart());
+    }
+  }
+
+  // paths and segments traced by the last render
+  [[nodiscard]] const path_stats& stats() const {
+    return stats_;
+  }
+
+  // seconds from the start of the last render until its first tile was done, which is how long
+  // an interactive preview would take to show anything. the wavefront integrator finishes every
+  // pixel of a band at once, so there it is the time of the first band
+  [[nodiscard]] double first_tile_seconds() const {
+    return first_tile_seconds_;
+  }
+
+  // options for the next render, such as the camera of the next frame of an animation
+  // the worker threads are kept unless the thread count changes, and the wavefront
+  // integrator's path buffers unless a wave holds more paths than before
+  void set_options(const options& opts) {
+    opts_ = opts;
+    initialize();
+    if (wavefront_) {
+      wavefront_->configure(opts_.image_width_, opts_.samples_per_pixel_, opts_.max_depth_,
+                            opts_.roulette_depth_, opts_.wavefront_size_, sampler_,
+                            tile_scheduler::thread_count(opts_.threads_));
+    }
+  }
+
+  // later renders stop early once stop is requested: tiles that have not started are skipped,
+  // the wavefront integrator returns after its current bounce, and the pixels come back
+  // incomplete. a render server cancels the job in flight with it
+  void set_stop_token(std::stop_token stop) {
+    stop_ = std::move(stop);
+  }
+
+  [[nodiscard]] int image_height() const {
+    return opts_.image_height_;
+  }
+
+  // the pixels of one frame, rendered but not written anywhere, for callers that store images
+  // themselves. checkpoints, streaming and partial renders do not apply
+  std::vector<color> render_pixels(const hittable& world) {
+    initialize();
+    render_start_ = std::chrono::steady_clock::now();
+    first_tile_seconds_ = -1;
+    return calculate_pixels(world);
+  }
+
+  // the camera ray render traces for sample `sample` of pixel (i, j)
+  // this thread's sampler is started for that sample, as it is before a path is traced
+  [[nodiscard]] ray primary_ray(const int i, const int j, const int sample) const {
+    begin_sample(i, j, sample);
+    return get_ray(i, j);
   }
 
  private:
+  // luminance below which the adaptive error target stops shrinking with the pixel
+  static constexpr double kAdaptiveFloor{0.01};
+
   void initialize() {
     opts_.image_height_ = static_cast<int>(opts_.image_width_ / opts_.aspect_ratio_);
     const auto real_aspect_ratio{static_cast<double>(opts_.image_width_) / opts_.image_height_};
@@ -92,6 +249,12 @@ class camera {
     opts_.pixel00_loc_ =
         opts_.viewport_upper_left_ + 0.5 * (opts_.pixel_delta_u_ + opts_.pixel_delta_v_);
     opts_.pixel_samples_scale_ = 1.0 / opts_.samples_per_pixel_;
+    sampler_ = sampler{opts_.sampler_, opts_.samples_per_pixel_, opts_.seed_};
+    stats_ = {};
+    aov_ = {};
+    if (opts_.adaptive_) {
+      sample_counts_.assign(static_cast<std::size_t>(opts_.image_width_) * opts_.image_height_, 0);
+    }
 
     // calculating camera defocus disk basis vectors
     const auto defocus_radius =
@@ -103,40 +266,483 @@ class camera {
     const auto total_pixels = opts_.image_width_ * opts_.image_height_;
     std::vector<color> pixels_buf{};
     pixels_buf.resize(total_pixels);
+    {
+      const utility::phase_timer phase{"pixels"};
+      if (opts_.denoise_ || opts_.write_aovs_) {
+        aov_ = aov_buffers{opts_.image_width_, opts_.image_height_};
+      }
+      calculate_band(world, 0, opts_.image_height_, pixels_buf);
+      if (stop_.stop_requested()) {
+        return pixels_buf;
+      }
+      if (!aov_.empty() && opts_.integrator_ == integrator::kWavefront && !opts_.adaptive_) {
+        trace_aovs(world);
+      }
+    }
+    if (opts_.denoise_) {
+      const utility::phase_timer phase{"denoise"};
+      denoise(pixels_buf, aov_,
+              denoise_params{.iterations_ = opts_.denoise_iterations_,
+                             .color_sigma_ = static_cast<real>(opts_.denoise_color_sigma_),
+                             .normal_sigma_ = static_cast<real>(opts_.denoise_normal_sigma_),
+                             .depth_sigma_ = static_cast<real>(opts_.denoise_depth_sigma_)});
+    }
+    return pixels_buf;
+  }
 
-#ifdef HAVE_OPENMP
-#pragma omp parallel for collapse(2) schedule(dynamic)
-#endif
-    for (int j = 0; j < opts_.image_height_; j++) {
-      for (int i = 0; i < opts_.image_width_; i++) {
-        color pixel_color = color{0, 0, 0};
-        for (int sample = 0; sample < opts_.samples_per_pixel_; sample++) {
-          ray r = get_ray(i, j);
-          pixel_color += ray_color(r, opts_.max_depth_, world);
-          pixels_buf[(j * opts_.image_width_) + i] = opts_.pixel_samples_scale_ * pixel_color;
+  // first-hit buffers of a wavefront render, which never holds the samples of one pixel
+  // together. the sampler gives every sample the camera ray the wavefront traced, so this only
+  // repeats their first intersections
+  void trace_aovs(const hittable& world) {
+    const auto tiles = make_tiles(opts_.image_width_, opts_.image_height_, opts_.tile_size_);
+    workers().run(tiles, [&](const tile& t, [[maybe_unused]] const int worker) {
+      for (int j = t.y0_; j < t.y1_; j++) {
+        for (int i = t.x0_; i < t.x1_; i++) {
+          first_hit features{};
+          for (int sample = 0; sample < opts_.samples_per_pixel_; sample++) {
+            const auto r = primary_ray(i, j, sample);
+            hit_record rec{};
+            const auto hit = world.closest_hit(r, interval{kRayEpsilon, +infinite}, rec);
+            record_first_hit(r, hit ? &rec : nullptr, features);
+          }
+          aov_.store((static_cast<std::size_t>(j) * opts_.image_width_) + i, features);
         }
       }
+    });
+  }
+
+  // add what camera ray r hit first to features, rec is null for a miss
+  static void record_first_hit(const ray& r, const hit_record* rec, first_hit& features) {
+    if (rec == nullptr) {
+      features.add(sky(r.direction()), vec3{0, 0, 0}, 0);
+      return;
     }
+    features.add(material_table::albedo(rec->material_id_), rec->normal_,
+                 rec->t_ * r.direction().length());
+  }
 
-    return pixels_buf;
+  // render the rows [y0, y1) into band, which holds just those rows
+  // adaptive sampling decides per pixel and always runs on the tile scheduler
+  void calculate_band(const hittable& world, const int y0, const int y1, std::span<color> band) {
+    if (stop_.stop_requested()) {
+      return;
+    }
+    if (opts_.integrator_ == integrator::kWavefront && !opts_.adaptive_) {
+      if (!wavefront_) {
+        wavefront_.emplace(opts_.image_width_, opts_.samples_per_pixel_, opts_.max_depth_,
+                           opts_.roulette_depth_, opts_.wavefront_size_, sampler_,
+                           tile_scheduler::thread_count(opts_.threads_));
+      }
+      wavefront_->render(world, [this](const int i, const int j) { return get_ray(i, j); },
+                         static_cast<std::size_t>(y0) * opts_.image_width_, band, stop_);
+      stats_ += wavefront_->stats();
+      note_first_tile(seconds_since_start());
+      return;
+    }
+
+    auto tiles = make_tiles(opts_.image_width_, y1 - y0, opts_.tile_size_);
+    for (auto& t : tiles) {
+      t.y0_ += y0;
+      t.y1_ += y0;
+    }
+    auto& scheduler = workers();
+    std::vector<std::vector<color>> tile_bufs(scheduler.threads());
+    std::vector<path_stats> worker_stats(scheduler.threads());
+    std::vector<double> first_done(scheduler.threads(), infinite);
+    scheduler.run(tiles, [&](const tile& t, const int worker) {
+      if (stop_.stop_requested()) {
+        return;
+      }
+      render_tile(world, t, tile_bufs[worker], band, y0, worker_stats[worker]);
+      first_done[worker] = std::min(first_done[worker], seconds_since_start());
+    });
+    for (const auto& s : worker_stats) {
+      stats_ += s;
+    }
+    note_first_tile(std::ranges::min(first_done));
+  }
+
+  // the worker pool, created on first use and kept across renders
+  tile_scheduler& workers() {
+    if (!scheduler_ || scheduler_->threads() != tile_scheduler::thread_count(opts_.threads_)) {
+      scheduler_.reset();
+      scheduler_.emplace(opts_.threads_);
+    }
+    return *scheduler_;
+  }
+
+  [[nodiscard]] double seconds_since_start() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - render_start_).count();
+  }
+
+  // keep the earliest tile of the render, bands after the first cannot be earlier
+  void note_first_tile(const double seconds) {
+    if (first_tile_seconds_ < 0 && seconds < infinite) {
+      first_tile_seconds_ = seconds;
+    }
+  }
+
+  // accumulate the tile in the worker's own buffer and copy it into the band once it is done,
+  // so workers never write to shared cache lines while tracing
+  void render_tile(const hittable& world, const tile& t, std::vector<color>& tile_buf,
+                   std::span<color> band, const int band_y0, path_stats& stats) {
+    tile_buf.resize(static_cast<std::size_t>(t.width()) * t.height());
+    const auto record = !aov_.empty();
+    for (int j = t.y0_; j < t.y1_; j++) {
+      for (int i = t.x0_; i < t.x1_; i++) {
+        const auto local = ((j - t.y0_) * t.width()) + (i - t.x0_);
+        first_hit features{};
+        auto* const features_out = record ? &features : nullptr;
+        if (opts_.adaptive_) {
+          tile_buf[local] = adaptive_pixel(world, i, j, stats, features_out);
+        } else {
+          tile_buf[local] =
+              opts_.pixel_samples_scale_ *
+              sample_pixel(world, i, j, 0, opts_.samples_per_pixel_, stats, features_out);
+        }
+        if (record) {
+          aov_.store((static_cast<std::size_t>(j) * opts_.image_width_) + i, features);
+        }
+      }
+    }
+    for (int j = t.y0_; j < t.y1_; j++) {
+      std::ranges::copy_n(tile_buf.begin() + ((j - t.y0_) * t.width()), t.width(),
+                          band.begin() + ((j - band_y0) * opts_.image_width_) + t.x0_);
+    }
+  }
+
+  // render band by band and hand every finished band to a background writer, so at most
+  // max_inflight_bands_ bands are in memory and disk writes overlap with tracing. a render stopped
+  // through set_stop_token() removes its file rather than leave a partial image behind
+  void render_streaming(const hittable& world) {
+    const utility::phase_timer phase{"streaming"};
+    const auto band_height = std::max(1, opts_.band_height_);
+    const auto bands = (opts_.image_height_ + band_height - 1) / band_height;
+    band_writer writer{output_path(), opts_.output_format_, opts_.image_width_,
+                       opts_.image_height_, opts_.max_inflight_bands_};
+    for (int k = 0; k < bands; k++) {
+      // bottom-up formats begin with the last band
+      const auto b = rows_bottom_up(opts_.output_format_) ? bands - 1 - k : k;
+      const auto y0 = b * band_height;
+      const auto y1 = std::min(opts_.image_height_, y0 + band_height);
+      auto band = writer.acquire(static_cast<std::size_t>(y1 - y0) * opts_.image_width_);
+      calculate_band(world, y0, y1, band);
+      if (stop_.stop_requested()) {
+        // the band may be incomplete, and a file missing its end must not look finished
+        writer.abandon();
+        return;
+      }
+      writer.submit(k, std::move(band));
+    }
+    writer.finish();
+  }
+
+  // point this thread's sampler at one sample of pixel (i, j)
+  // every sample value comes from the sampler, so the result does not depend on the thread, tile
+  // or integrator that traces it
+  void begin_sample(const int i, const int j, const int sample) const {
+    auto& s = thread_sampler();
+    s = sampler_;
+    s.start((static_cast<std::uint64_t>(j) * opts_.image_width_) + i,
+            static_cast<std::uint32_t>(sample));
+  }
+
+  // sum of the samples [first, first + n) of pixel (i, j), their first hits go to features
+  // unless it is null
+  [[nodiscard]] color sample_pixel(const hittable& world, const int i, const int j,
+                                   const int first, const int n, path_stats& stats,
+                                   first_hit* features = nullptr) const {
+    color pixel_color = color{0, 0, 0};
+    for (int sample = first; sample < first + n; sample++) {
+      begin_sample(i, j, sample);
+      pixel_color += ray_color(get_ray(i, j), world, stats, features);
+    }
+    return pixel_color;
+  }
+
+  // mean of a pixel sampled until its luminance converged, see options::adaptive_
+  // the running mean and variance use welford's update, which stays accurate over many samples
+  [[nodiscard]] color adaptive_pixel(const hittable& world, const int i, const int j,
+                                     path_stats& stats, first_hit* features = nullptr) {
+    const auto min_samples = std::max(2, opts_.adaptive_min_samples_);
+    const auto max_samples = std::max(min_samples, opts_.adaptive_max_samples_);
+    const auto batch = std::max(1, opts_.adaptive_batch_);
+    color sum{0, 0, 0};
+    double mean{0};
+    double m2{0};
+    int n{0};
+    while (n < max_samples) {
+      const auto todo = n < min_samples ? min_samples - n : std::min(batch, max_samples - n);
+      for (int sample = 0; sample < todo; sample++) {
+        begin_sample(i, j, n);
+        const auto radiance = ray_color(get_ray(i, j), world, stats, features);
+        sum += radiance;
+        n++;
+        const auto y = luminance(radiance);
+        const auto delta = y - mean;
+        mean += delta / n;
+        m2 += delta * (y - mean);
+      }
+      // standard error of the mean, against a floor so near-black pixels can converge too
+      const auto std_error = std::sqrt(m2 / (n - 1) / n);
+      if (std_error <= opts_.adaptive_error_ * std::max(mean, kAdaptiveFloor)) {
+        break;
+      }
+    }
+    sample_counts_[(static_cast<std::size_t>(j) * opts_.image_width_) + i] =
+        static_cast<std::uint32_t>(n);
+    return sum / n;
+  }
+
+  // samples per pixel of the last adaptive render as a grey image, white at the maximum
+  void write_sample_map() {
+    const auto max_samples =
+        std::max({1, opts_.adaptive_min_samples_, opts_.adaptive_max_samples_});
+    std::vector<color> map(sample_counts_.size());
+    std::uint64_t total{0};
+    for (std::size_t p = 0; p < map.size(); p++) {
+      const auto v = static_cast<real>(sample_counts_[p]) / static_cast<real>(max_samples);
+      map[p] = color{v, v, v};
+      total += sample_counts_[p];
+    }
+    const auto path = opts_.sample_map_path_.empty()
+                          ? std::format("output.samples.{}", image_extension(opts_.output_format_))
+                          : opts_.sample_map_path_;
+    write_image(path, opts_.output_format_, opts_.image_width_, opts_.image_height_, map);
+    timer_.report(std::format("[render]: {:.1f} samples per pixel on average, map written to {}.",
+                              static_cast<double>(total) / std::max<std::size_t>(1, map.size()),
+                              path));
+  }
+
+  // render into a film that is resumed from and saved to checkpoint_path_
+  // samples_per_pixel_ is the total per pixel, so a resumed render only traces what is missing
+  // and a later run with a higher count adds to the earlier samples. the film is saved every
+  // checkpoint_interval_ seconds, and SIGINT stops the render after the pixels in progress and
+  // saves it without writing the image
+  void render_checkpointed(const hittable& world) {
+    const utility::phase_timer phase{"checkpointed"};
+    const auto hash = scene_hash(world);
+    auto acc = film{opts_.image_width_, opts_.image_height_};
+    if (world.hash() == hittable::kUnhashed) {
+      timer_.report(std::format(
+          "[render]: the scene has objects without a hash(), {} is not resumed.",
+          opts_.checkpoint_path_));
+    } else if (auto loaded = film::load(opts_.checkpoint_path_, opts_.image_width_,
+                                        opts_.image_height_, hash)) {
+      acc = std::move(*loaded);
+      // samples traced from here on follow no tile or sample range, so it no longer merges
+      acc.set_coverage(0, {});
+    }
+    const auto target = static_cast<std::uint32_t>(std::max(0, opts_.samples_per_pixel_));
+    std::uint64_t resumed{0};
+    for (const auto count : acc.samples()) {
+      resumed += std::min(count, target);
+    }
+    timer_.report(std::format("[render]: resuming {} of {} samples from {}.", resumed,
+                              static_cast<std::uint64_t>(target) * acc.samples().size(),
+                              opts_.checkpoint_path_));
+
+    std::mutex film_mutex{};
+    std::condition_variable_any saver_cv{};
+    std::jthread saver{[&](const std::stop_token stop) {
+      std::unique_lock lock{film_mutex};
+      const auto interval = std::chrono::seconds{std::max(1, opts_.checkpoint_interval_)};
+      while (!saver_cv.wait_for(lock, stop, interval, [] { return false; })) {
+        if (stop.stop_requested()) {
+          return;
+        }
+        acc.save(opts_.checkpoint_path_, hash);
+      }
+    }};
+
+    interrupted_ = false;
+    const auto previous = std::signal(SIGINT, [](int) { interrupted_ = true; });
+    const auto tiles = make_tiles(opts_.image_width_, opts_.image_height_, opts_.tile_size_);
+    auto& scheduler = workers();
+    std::vector<std::vector<color>> tile_bufs(scheduler.threads());
+    std::vector<path_stats> worker_stats(scheduler.threads());
+    scheduler.run(tiles, [&](const tile& t, const int worker) {
+      auto& tile_buf = tile_bufs[worker];
+      tile_buf.assign(static_cast<std::size_t>(t.width()) * t.height(), color{0, 0, 0});
+      auto& samples = acc.samples();
+      // every pixel belongs to one tile, so reading its count without the lock is safe
+      int done_rows{0};
+      for (int j = t.y0_; j < t.y1_ && !interrupted_; j++, done_rows++) {
+        for (int i = t.x0_; i < t.x1_; i++) {
+          const auto p = (static_cast<std::size_t>(j) * opts_.image_width_) + i;
+          const auto existing = std::min(samples[p], target);
+          tile_buf[((j - t.y0_) * t.width()) + (i - t.x0_)] =
+              sample_pixel(world, i, j, static_cast<int>(existing),
+                           static_cast<int>(target - existing), worker_stats[worker]);
+        }
+      }
+      const std::scoped_lock lock{film_mutex};
+      for (int j = t.y0_; j < t.y0_ + done_rows; j++) {
+        for (int i = t.x0_; i < t.x1_; i++) {
+          const auto p = (static_cast<std::size_t>(j) * opts_.image_width_) + i;
+          acc.sum()[p] += tile_buf[((j - t.y0_) * t.width()) + (i - t.x0_)];
+          samples[p] = std::max(samples[p], target);
+        }
+      }
+      note_first_tile(seconds_since_start());
+    });
+    std::signal(SIGINT, previous);
+    for (const auto& s : worker_stats) {
+      stats_ += s;
+    }
+    saver.request_stop();
+    saver.join();
+
+    if (!acc.save(opts_.checkpoint_path_, hash)) {
+      timer_.report(std::format("[render]: failed to save checkpoint {}.", opts_.checkpoint_path_));
+    }
+    if (interrupted_) {
+      timer_.report(std::format("[render]: interrupted, progress saved to {}.",
+                                opts_.checkpoint_path_));
+      return;
+    }
+    write2file(acc.resolve());
+  }
+
+  // trace the tile and sample ranges of a partial render, see options::partial_path_
+  // every sample keeps the index it has in the full render, so the sampler gives it the same
+  // values and the merged partials match a single render of the frame. adaptive sampling and
+  // the wavefront integrator do not apply, partials are traced tile by tile
+  void render_partial(const hittable& world) {
+    const utility::phase_timer phase{"partial"};
+    const auto tiles = make_tiles(opts_.image_width_, opts_.image_height_, opts_.tile_size_);
+    const auto tile_count = static_cast<int>(tiles.size());
+    const auto tile_end = opts_.tile_end_ < 0 ? tile_count : std::min(opts_.tile_end_, tile_count);
+    const auto tile_begin = std::clamp(opts_.tile_begin_, 0, tile_end);
+    const auto sample_end = opts_.sample_end_ < 0 ? opts_.samples_per_pixel_ : opts_.sample_end_;
+    const auto sample_begin = std::clamp(opts_.sample_begin_, 0, sample_end);
+    timer_.report(std::format("[render]: partial of tiles [{}, {}) of {}, samples [{}, {}).",
+                              tile_begin, tile_end, tile_count, sample_begin, sample_end));
+
+    film acc{opts_.image_width_, opts_.image_height_};
+    auto& scheduler = workers();
+    std::vector<path_stats> worker_stats(scheduler.threads());
+    std::vector<double> first_done(scheduler.threads(), infinite);
+    const auto range = std::span{tiles}.subspan(tile_begin, tile_end - tile_begin);
+    const auto count = sample_end - sample_begin;
+    // tiles do not overlap, so every pixel of the film is written by one worker
+    scheduler.run(range, [&](const tile& t, const int worker) {
+      for (int j = t.y0_; j < t.y1_; j++) {
+        for (int i = t.x0_; i < t.x1_; i++) {
+          const auto p = (static_cast<std::size_t>(j) * opts_.image_width_) + i;
+          acc.sum()[p] = sample_pixel(world, i, j, sample_begin, count, worker_stats[worker]);
+          acc.samples()[p] = static_cast<std::uint32_t>(count);
+        }
+      }
+      first_done[worker] = std::min(first_done[worker], seconds_since_start());
+    });
+    for (const auto& s : worker_stats) {
+      stats_ += s;
+    }
+    note_first_tile(std::ranges::min(first_done));
+    acc.set_coverage(std::max(1, opts_.tile_size_),
+                     {film_range{.tile_begin_ = static_cast<std::uint32_t>(tile_begin),
+                                 .tile_end_ = static_cast<std::uint32_t>(tile_end),
+                                 .sample_begin_ = static_cast<std::uint32_t>(sample_begin),
+                                 .sample_end_ = static_cast<std::uint32_t>(sample_end)}});
+    if (!acc.save(opts_.partial_path_, scene_hash(world))) {
+      timer_.report(std::format("[render]: failed to save partial {}.", opts_.partial_path_));
+    }
+  }
+
+  // fingerprint of the scene and of every option that changes what a sample means
+  // the sample count, integrator and thread settings are left out, so they can change on resume
+  [[nodiscard]] std::uint64_t scene_hash(const hittable& world) const {
+    return hasher{}
+        .add(world.hash())
+        .add(opts_.image_width_)
+        .add(opts_.image_height_)
+        .add(opts_.max_depth_)
+        .add(opts_.vfov_)
+        .add(opts_.lookfrom_)
+        .add(opts_.lookat_)
+        .add(opts_.vup_)
+        .add(opts_.defocus_angle_)
+        .add(opts_.focus_dis_)
+        .value();
+  }
+
+  void write2file(const std::vector<color>& pixels_buf) const {
+    const utility::phase_timer phase{"write"};
+    write_image(output_path(), opts_.output_format_, opts_.image_width_, opts_.image_height_,
+                pixels_buf);
   }
 
-  template <typename Pixels>
-  void write2file(const std::vector<Pixels>& pixels_buf) {
-    std::ofstream ofs("output.ppm", std::ios::trunc | std::ios::binary);
-    std::vector<char> file_buf{};
-    file_buf.reserve(kMaxBufSize);
-    std::format_to(std::back_inserter(file_buf), "P3\n{} {}\n255\n", opts_.image_width_,
-                   opts_.image_height_);
-    for (const auto& pixel : pixels_buf) {
-      std::format_to(std::back_inserter(file_buf), "{}\n", as_color(pixel));
+  // the first-hit buffers of the last render, next to the image as <image stem>.albedo.<ext>,
+  // <image stem>.normal.<ext> and <image stem>.depth.<ext>. ppm holds values in [0, 1] after
+  // gamma correction, so there normals are mapped from [-1, 1], depths are divided by the
+  // largest one, and both are squared to come out of the gamma unchanged
+  void write_aovs() {
+    const auto ldr = opts_.output_format_ != image_format::kPFM;
+    const auto stem = output_stem();
+    const auto ext = image_extension(opts_.output_format_);
+    const auto write = [&](const std::string_view name, std::span<const color> buf) {
+      write_image(std::format("{}.{}.{}", stem, name, ext), opts_.output_format_,
+                  opts_.image_width_, opts_.image_height_, buf);
+    };
+    write("albedo", aov_.albedo_);
+    std::vector<color> buf(aov_.normal_.size());
+    for (std::size_t p = 0; p < buf.size(); p++) {
+      const auto n = aov_.normal_[p];
+      buf[p] = ldr ? 0.25 * (n + color{1, 1, 1}) * (n + color{1, 1, 1}) : n;
+    }
+    write("normal", buf);
+    const auto far = ldr ? std::ranges::max(aov_.depth_) : real{1};
+    for (std::size_t p = 0; p < buf.size(); p++) {
+      const auto v = far > 0 ? aov_.depth_[p] / far : real{0};
+      buf[p] = ldr ? color{v * v, v * v, v * v} : color{v, v, v};
+    }
+    write("depth", buf);
+    timer_.report(std::format("[render]: albedo, normal and depth written to {}.*.{}.", stem, ext));
+  }
+
+  // the metrics report goes next to the image, as <image stem>.metrics.json
+  // counts cover everything since the process started, scene construction included
+  void write_metrics(const double seconds) {
+    const auto path = output_stem() + ".metrics.json";
+    const auto rays = utility::metrics::totals().rays();
+    const std::array<std::pair<std::string, double>, 5> summary{{
+        {"image_width", opts_.image_width_},
+        {"image_height", opts_.image_height_},
+        {"samples_per_pixel", opts_.samples_per_pixel_},
+        {"render_seconds", seconds},
+        {"rays_per_second", seconds > 0 ? static_cast<double>(rays) / seconds : 0.0},
+    }};
+    static constexpr std::array<std::string_view, kMaterialKinds> kKindNames{
+        "lambertian", "metal", "dielectric", "custom"};
+    if (utility::metrics::write_json(path, summary, kKindNames)) {
+      timer_.report(std::format("[render]: metrics written to {}.", path));
+    } else {
+      timer_.report(std::format("[render]: failed to write metrics to {}.", path));
     }
-    ofs.write(file_buf.data(), std::ssize(file_buf));
+  }
+
+  [[nodiscard]] std::string output_path() const {
+    if (!opts_.output_path_.empty()) {
+      return opts_.output_path_;
+    }
+    return std::format("output.{}", image_extension(opts_.output_format_));
+  }
+
+  // the output path without its extension
+  [[nodiscard]] std::string output_stem() const {
+    auto path = output_path();
+    if (const auto dot = path.find_last_of('.');
+        dot != std::string::npos && path.find_first_of('/', dot) == std::string::npos) {
+      path.resize(dot);
+    }
+    return path;
   }
 
   [[nodiscard]] vec3 sample_square() const {
     // random vector point in [-.5,-.5,0] to [+.5,+.5,0]
-    return vec3{random_double() - 0.5, random_double() - 0.5, 0};
+    const auto [u, v] = thread_sampler().get_2d();
+    return vec3{static_cast<real>(u - 0.5), static_cast<real>(v - 0.5), 0};
   }
 
   [[nodiscard]] ray get_ray(const int i, const int j) const {
@@ -148,35 +754,66 @@ class camera {
     return {ray_cen, ray_dir};
   }
 
-  [[nodiscard]] color ray_color(const ray& r, int depth, const hittable& world) const {
-    if (depth <= 0) {
-      return color{0, 0, 0};
-    }
-    hit_record rec{};
-    // the intersection point may result in round to zeor if t is too small
-    // we should ignore such root
-    if (world.hit(r, interval{0.00001, +infinite}, rec)) {
+  // radiance along r, following the path iteratively with its throughput
+  // after roulette_depth_ segments a path survives each bounce with a probability that follows
+  // its throughput and is reweighted by 1 / p when it does, which keeps the estimate unbiased.
+  // max_depth_ only remains as a safety cap. what the camera ray hits first is added to
+  // features, unless it is null
+  [[nodiscard]] color ray_color(ray r, const hittable& world, path_stats& stats,
+                                first_hit* features = nullptr) const {
+    stats.paths_++;
+    color throughput{1, 1, 1};
+    for (int depth = 0; depth < opts_.max_depth_; depth++) {
+      stats.segments_++;
+      utility::metrics::count_rays(depth, 1);
+      hit_record rec{};
+      // the intersection point may result in round to zeor if t is too small
+      // we should ignore such root
+      const auto hit = world.closest_hit(r, interval{kRayEpsilon, +infinite}, rec);
+      if (depth == 0 && features != nullptr) {
+        record_first_hit(r, hit ? &rec : nullptr, *features);
+      }
+      if (!hit) {
+        return throughput * sky(r.direction());
+      }
       ray scattered{};
       color attenuation;
-      if (rec.material_->scatter(r, rec, attenuation, scattered)) {
-        // reflection occur here!!!
-        return attenuation * ray_color(scattered, depth - 1, world);
+      if (!material_table::scatter(rec.material_id_, r, rec, attenuation, scattered)) {
+        return color{0, 0, 0};
+      }
+      // reflection occur here!!!
+      throughput = throughput * attenuation;
+      r = scattered;
+      if (depth + 1 >= opts_.roulette_depth_) {
+        const auto survival = survival_probability(throughput);
+        if (sample_1d() >= survival) {
+          return color{0, 0, 0};
+        }
+        throughput /= survival;
       }
-      return color{0, 0, 0};
     }
-    const vec3 unit_dir = unit_vec(r.direction());
-    const auto a{0.5 * (unit_dir.y() + 1.0)};
-    return (1.0 - a) * color{1.0, 1.0, 1.0} + a * color{0.5, 0.7, 1.0};
+    return color{0, 0, 0};
   }
 
   [[nodiscard]] point3 defocus_disk_sample() const {
-    auto p = random_in_unit_disk();
+    auto p = sample_unit_disk();
     return opts_.center_ + (p.x() * opts_.defocus_disk_u_) + (p.y() * opts_.defocus_disk_v_);
   }
 
  private:
   options opts_{};
   timer timer_{};
+  std::optional<wavefront_integrator> wavefront_{};
+  std::optional<tile_scheduler> scheduler_{};
+  std::vector<std::uint32_t> sample_counts_{};  // per pixel, filled by adaptive renders
+  aov_buffers aov_{};  // first hits of the last whole-frame render, when denoising or writing them
+  path_stats stats_{};                          // paths traced by the last render
+  std::chrono::steady_clock::time_point render_start_{};
+  double first_tile_seconds_{-1};  // negative until a tile of the current render is done
+  sampler sampler_{};                           // copied into each thread for every sample
+  std::stop_token stop_{};                      // cancels renders, see set_stop_token
+  // set from the SIGINT handler while a checkpointed render runs
+  inline static std::atomic<bool> interrupted_{false};
 };
 
 }  // namespace raytracer
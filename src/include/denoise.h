@@ -0,0 +1,182 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "color.h"
+#include "vec3.h"
+
+namespace raytracer {
+
+// what the camera ray of one sample hit first, summed over the samples of a pixel
+// a miss counts the sky as albedo, a zero normal and zero depth
+struct first_hit {
+  color albedo_{0, 0, 0};  // NOLINT
+  vec3 normal_{0, 0, 0};   // NOLINT shading normal, facing the camera
+  real depth_{0};          // NOLINT distance from the ray origin to the hit
+  int samples_{0};         // NOLINT
+
+  void add(const color& albedo, const vec3& normal, const real depth) {
+    albedo_ += albedo;
+    normal_ += normal;
+    depth_ += depth;
+    samples_++;
+  }
+};
+
+// per pixel first-hit albedo, normal and depth of a frame, averaged over the pixel's samples
+// they are smooth where the scene is and change sharply at its edges, which is what the
+// denoiser needs to tell noise from detail
+struct aov_buffers {
+  int width_{};                  // NOLINT
+  int height_{};                 // NOLINT
+  std::vector<color> albedo_{};  // NOLINT
+  std::vector<vec3> normal_{};   // NOLINT
+  std::vector<real> depth_{};    // NOLINT
+
+  aov_buffers() = default;
+  aov_buffers(const int width, const int height)
+      : width_{width},
+        height_{height},
+        albedo_(static_cast<std::size_t>(width) * height),
+        normal_(albedo_.size()),
+        depth_(albedo_.size()) {}
+
+  [[nodiscard]] bool empty() const {
+    return albedo_.empty();
+  }
+
+  // the mean of the samples of pixel p
+  void store(const std::size_t p, const first_hit& hit) {
+    const auto scale = real{1} / static_cast<real>(std::max(1, hit.samples_));
+    albedo_[p] = scale * hit.albedo_;
+    normal_[p] = scale * hit.normal_;
+    depth_[p] = scale * hit.depth_;
+  }
+};
+
+// edge-stopping weights of the a-trous filter, see denoise()
+struct denoise_params {
+  int iterations_{5};       // NOLINT passes, the footprint doubles with each
+  real color_sigma_{0.5};   // NOLINT tolerated difference of the demodulated colors
+  real normal_sigma_{0.1};  // NOLINT tolerated difference of the normals
+  real depth_sigma_{0.05};  // NOLINT tolerated relative difference of the depths
+};
+
+// edge-avoiding a-trous wavelet filter (dammertz et al. 2010) over the pixels of a frame
+// colors are divided by the albedo first, so the filter smooths lighting and not the texture
+// of the surfaces, and multiplied back at the end. every pass is a 5x5 b3-spline kernel with
+// holes, 2^pass pixels between taps, whose taps are weighted down by how much their color,
+// normal and depth differ from the center pixel. the color tolerance halves with each pass as
+// the noise left goes down. the channels are kept in planes of floats and each pass adds one
+// tap to a whole row at a time, so the inner loops are contiguous and vectorize, and rows are
+// filtered in parallel
+inline void denoise(std::span<color> pixels, const aov_buffers& aov,
+                    const denoise_params& params) {
+  static constexpr std::array<float, 5> kKernel{1.0F / 16, 1.0F / 4, 3.0F / 8, 1.0F / 4,
+                                                1.0F / 16};
+  static constexpr float kMinAlbedo{1e-3F};
+  static constexpr float kMinDepth{1e-4F};
+  const auto width = aov.width_;
+  const auto height = aov.height_;
+  const auto size = static_cast<std::size_t>(width) * height;
+  if (aov.empty() || pixels.size() != size || params.iterations_ <= 0) {
+    return;
+  }
+
+  using plane = std::vector<float>;
+  std::array<plane, 3> albedo{plane(size), plane(size), plane(size)};
+  std::array<plane, 3> normal{plane(size), plane(size), plane(size)};
+  std::array<plane, 3> rgb{plane(size), plane(size), plane(size)};
+  std::array<plane, 3> next{plane(size), plane(size), plane(size)};
+  plane depth(size);
+  for (std::size_t p = 0; p < size; p++) {
+    const std::array<real, 3> a{aov.albedo_[p].x(), aov.albedo_[p].y(), aov.albedo_[p].z()};
+    const std::array<real, 3> n{aov.normal_[p].x(), aov.normal_[p].y(), aov.normal_[p].z()};
+    const std::array<real, 3> c{pixels[p].x(), pixels[p].y(), pixels[p].z()};
+    for (int k = 0; k < 3; k++) {
+      albedo[k][p] = std::max(static_cast<float>(a[k]), kMinAlbedo);
+      normal[k][p] = static_cast<float>(n[k]);
+      rgb[k][p] = static_cast<float>(c[k]) / albedo[k][p];
+    }
+    depth[p] = static_cast<float>(aov.depth_[p]);
+  }
+
+  const auto inv_normal = 1.0F / static_cast<float>(params.normal_sigma_ * params.normal_sigma_);
+  const auto depth_sigma = static_cast<float>(params.depth_sigma_);
+  for (int pass = 0; pass < params.iterations_; pass++) {
+    const auto step = 1 << pass;
+    const auto color_sigma = static_cast<float>(params.color_sigma_) / static_cast<float>(step);
+    const auto inv_color = 1.0F / (color_sigma * color_sigma);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int j = 0; j < height; j++) {
+      const auto row = static_cast<std::size_t>(j) * width;
+      std::vector<float> sum_w(width, 0.0F);
+      std::array<std::vector<float>, 3> sum{std::vector<float>(width, 0.0F),
+                                            std::vector<float>(width, 0.0F),
+                                            std::vector<float>(width, 0.0F)};
+      // depth differences relative to the center's depth, looser for taps further away
+      std::vector<float> depth_scale(width);
+      for (int i = 0; i < width; i++) {
+        depth_scale[i] =
+            1.0F / (std::max(depth[row + i], kMinDepth) * depth_sigma * static_cast<float>(step));
+      }
+      for (int dy = -2; dy <= 2; dy++) {
+        const auto y = j + (dy * step);
+        if (y < 0 || y >= height) {
+          continue;
+        }
+        const auto tap_row = static_cast<std::size_t>(y) * width;
+        for (int dx = -2; dx <= 2; dx++) {
+          const auto offset = dx * step;
+          const auto kernel = kKernel[dy + 2] * kKernel[dx + 2];
+          // taps outside the image are left out, the weights are normalized below
+          const auto begin = std::clamp(-offset, 0, width);
+          const auto end = std::clamp(width - offset, begin, width);
+          for (int i = begin; i < end; i++) {
+            const auto p = row + i;
+            const auto q = tap_row + i + offset;
+            const auto dr = rgb[0][p] - rgb[0][q];
+            const auto dg = rgb[1][p] - rgb[1][q];
+            const auto db = rgb[2][p] - rgb[2][q];
+            const auto nx = normal[0][p] - normal[0][q];
+            const auto ny = normal[1][p] - normal[1][q];
+            const auto nz = normal[2][p] - normal[2][q];
+            const auto dz = (depth[p] - depth[q]) * depth_scale[i];
+            const auto w = kernel * std::exp(-(((dr * dr) + (dg * dg) + (db * db)) * inv_color) -
+                                             (((nx * nx) + (ny * ny) + (nz * nz)) * inv_normal) -
+                                             (dz * dz));
+            sum_w[i] += w;
+            sum[0][i] += w * rgb[0][q];
+            sum[1][i] += w * rgb[1][q];
+            sum[2][i] += w * rgb[2][q];
+          }
+        }
+      }
+      // the center tap always has full weight, so sum_w is never zero
+      for (int k = 0; k < 3; k++) {
+        for (int i = 0; i < width; i++) {
+          next[k][row + i] = sum[k][i] / sum_w[i];
+        }
+      }
+    }
+    std::swap(rgb, next);
+  }
+
+  for (std::size_t p = 0; p < size; p++) {
+    pixels[p] = color{static_cast<real>(rgb[0][p] * albedo[0][p]),
+                      static_cast<real>(rgb[1][p] * albedo[1][p]),
+                      static_cast<real>(rgb[2][p] * albedo[2][p])};
+  }
+}
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <cstdint>
+
+#include "hittable.h"
+#include "instance.h"
+#include "sphere.h"
+
+namespace raytracer {
+
+// built-in primitive types, tagged once when an object enters an aggregate
+enum class primitive_kind : std::uint8_t {
+  kSphere,
+  kInstance,
+  kCustom,  // any other hittable, reached through the virtual interface
+};
+
+inline primitive_kind primitive_kind_of(const hittable& obj) {
+  if (dynamic_cast<const sphere*>(&obj) != nullptr) {
+    return primitive_kind::kSphere;
+  }
+  if (dynamic_cast<const instance*>(&obj) != nullptr) {
+    return primitive_kind::kInstance;
+  }
+  return primitive_kind::kCustom;
+}
+
+// obj.hit(), called directly on the final built-in class when the tag names one, so the
+// intersection code can be inlined into the aggregate's loop
+inline bool dispatch_hit(const primitive_kind kind, const hittable& obj, const ray& r,
+                         const interval& ray_t, hit_record& rec) {
+  switch (kind) {
+    case primitive_kind::kSphere:
+      return static_cast<const sphere&>(obj).hit(r, ray_t, rec);
+    case primitive_kind::kInstance:
+      return static_cast<const instance&>(obj).hit(r, ray_t, rec);
+    case primitive_kind::kCustom:
+      break;
+  }
+  return obj.hit(r, ray_t, rec);
+}
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef FILM_H
+#define FILM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "color.h"
+
+namespace raytracer {
+
+// the tiles [tile_begin_, tile_end_) of a frame, in make_tiles() order, and the samples
+// [sample_begin_, sample_end_) of their pixels
+struct film_range {
+  std::uint32_t tile_begin_{};    // NOLINT
+  std::uint32_t tile_end_{};      // NOLINT
+  std::uint32_t sample_begin_{};  // NOLINT
+  std::uint32_t sample_end_{};    // NOLINT
+
+  // true if some sample of some pixel lies in both
+  [[nodiscard]] bool overlaps(const film_range& other) const {
+    return tile_begin_ < other.tile_end_ && other.tile_begin_ < tile_end_ &&
+           sample_begin_ < other.sample_end_ && other.sample_begin_ < sample_end_;
+  }
+};
+
+// per-pixel radiance sums and sample counts
+// unlike a finished image, films can be saved, reloaded and topped up with more samples
+// partial films also record the tile and sample ranges they cover, so partials can be summed
+// without counting any sample twice
+class film {
+ public:
+  film() = default;
+  film(const int width, const int height)
+      : width_{width},
+        height_{height},
+        sum_(static_cast<std::size_t>(width) * height, color{0, 0, 0}),
+        samples_(static_cast<std::size_t>(width) * height, 0) {}
+
+  [[nodiscard]] int width() const {
+    return width_;
+  }
+  [[nodiscard]] int height() const {
+    return height_;
+  }
+  [[nodiscard]] std::vector<color>& sum() {
+    return sum_;
+  }
+  [[nodiscard]] const std::vector<color>& sum() const {
+    return sum_;
+  }
+  [[nodiscard]] std::vector<std::uint32_t>& samples() {
+    return samples_;
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& samples() const {
+    return samples_;
+  }
+
+  // tile size of the ranges, 0 when the film does not record what it covers (checkpoints)
+  [[nodiscard]] int tile_size() const {
+    return static_cast<int>(tile_size_);
+  }
+  [[nodiscard]] const std::vector<film_range>& ranges() const {
+    return ranges_;
+  }
+
+  // record that the film holds the samples of ranges, tiled tile_size pixels square
+  // tile_size 0 records nothing, for a film whose samples no longer follow ranges
+  void set_coverage(const int tile_size, std::vector<film_range> ranges) {
+    tile_size_ = static_cast<std::uint32_t>(std::max(0, tile_size));
+    ranges_ = tile_size_ > 0 ? std::move(ranges) : std::vector<film_range>{};
+  }
+
+  // add the sums and sample counts of other, a partial of the same frame rendered separately
+  // throws std::runtime_error if the sizes or tilings differ, either film does not record what
+  // it covers, or both hold samples of one range
+  film& operator+=(const film& other) {
+    if (width_ != other.width_ || height_ != other.height_) {
+      throw std::runtime_error(std::format("film of {}x{} pixels added to one of {}x{}",
+                                           other.width_, other.height_, width_, height_));
+    }
+    if (tile_size_ == 0 || other.tile_size_ == 0) {
+      throw std::runtime_error("film without tile and sample ranges");
+    }
+    if (tile_size_ != other.tile_size_) {
+      throw std::runtime_error(
+          std::format("film tiled by {} added to one tiled by {}", other.tile_size_, tile_size_));
+    }
+    for (const auto& mine : ranges_) {
+      for (const auto& theirs : other.ranges_) {
+        if (mine.overlaps(theirs)) {
+          throw std::runtime_error(std::format(
+              "tiles [{}, {}) samples [{}, {}) are already covered", theirs.tile_begin_,
+              theirs.tile_end_, theirs.sample_begin_, theirs.sample_end_));
+        }
+      }
+    }
+    for (std::size_t p = 0; p < sum_.size(); p++) {
+      sum_[p] += other.sum_[p];
+      samples_[p] += other.samples_[p];
+    }
+    ranges_.insert(ranges_.end(), other.ranges_.begin(), other.ranges_.end());
+    return *this;
+  }
+
+  // mean radiance of every pixel, black where no sample was taken yet
+  [[nodiscard]] std::vector<color> resolve() const {
+    std::vector<color> pixels(sum_.size());
+    const auto count = static_cast<std::int64_t>(sum_.size());
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::int64_t p = 0; p < count; p++) {
+      pixels[p] = samples_[p] > 0 ? sum_[p] / samples_[p] : color{0, 0, 0};
+    }
+    return pixels;
+  }
+
+  // file layout, in the native byte order of the writer:
+  //   header (see below), range_count film_ranges, then width * height records of
+  //   {float r, g, b; uint32 samples}
+  // the header's byte order marker reads back differently on a host of the other byte order,
+  // whose loads then reject the file instead of misreading it
+  // the scene hash identifies the scene and camera the sums belong to
+  // the file is written next to the target and renamed over it, so an interrupted save leaves
+  // the previous checkpoint intact
+  bool save(const std::string& path, const std::uint64_t scene_hash) const {
+    const auto tmp_path = path + ".tmp";
+    {
+      std::ofstream ofs(tmp_path, std::ios::trunc | std::ios::binary);
+      const header head{.magic_ = kMagic,
+                        .width_ = static_cast<std::uint32_t>(width_),
+                        .height_ = static_cast<std::uint32_t>(height_),
+                        .byte_order_ = kByteOrder,
+                        .tile_size_ = tile_size_,
+                        .scene_hash_ = scene_hash,
+                        .range_count_ = static_cast<std::uint32_t>(ranges_.size())};
+      ofs.write(reinterpret_cast<const char*>(&head), sizeof(head));
+      ofs.write(reinterpret_cast<const char*>(ranges_.data()),
+                static_cast<std::streamsize>(ranges_.size() * sizeof(film_range)));
+      std::vector<record> records(sum_.size());
+      for (std::size_t p = 0; p < sum_.size(); p++) {
+        records[p] = record{.rgb_ = {static_cast<float>(sum_[p].x()),
+                                     static_cast<float>(sum_[p].y()),
+                                     static_cast<float>(sum_[p].z())},
+                            .samples_ = samples_[p]};
+      }
+      ofs.write(reinterpret_cast<const char*>(records.data()),
+                static_cast<std::streamsize>(records.size() * sizeof(record)));
+      if (!ofs) {
+        return false;
+      }
+    }
+    std::error_code ec{};
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+  }
+
+  // the film stored at path, if there is one of the given size and scene
+  static std::optional<film> load(const std::string& path, const int width, const int height,
+                                  const std::uint64_t scene_hash) {
+    auto stored = read(path);
+    if (!stored || stored->first.width_ != width || stored->first.height_ != height ||
+        stored->second != scene_hash) {
+      return std::nullopt;
+    }
+    return std::move(stored->first);
+  }
+
+  // the film stored at path, whatever its size, with the scene hash it was saved with
+  static std::optional<std::pair<film, std::uint64_t>> read(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    header head{};
+    if (!ifs.read(reinterpret_cast<char*>(&head), sizeof(head)) || head.magic_ != kMagic ||
+        head.byte_order_ != kByteOrder || head.width_ == 0 || head.height_ == 0 ||
+        head.width_ > kMaxSide || head.height_ > kMaxSide || head.range_count_ > kMaxRanges) {
+      return std::nullopt;
+    }
+    film result{static_cast<int>(head.width_), static_cast<int>(head.height_)};
+    std::vector<film_range> ranges(head.range_count_);
+    if (!ifs.read(reinterpret_cast<char*>(ranges.data()),
+                  static_cast<std::streamsize>(ranges.size() * sizeof(film_range)))) {
+      return std::nullopt;
+    }
+    result.set_coverage(static_cast<int>(head.tile_size_), std::move(ranges));
+    std::vector<record> records(result.sum_.size());
+    if (!ifs.read(reinterpret_cast<char*>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(record)))) {
+      return std::nullopt;
+    }
+    for (std::size_t p = 0; p < records.size(); p++) {
+      result.sum_[p] = color{records[p].rgb_[0], records[p].rgb_[1], records[p].rgb_[2]};
+      result.samples_[p] = records[p].samples_;
+    }
+    return std::pair{std::move(result), head.scene_hash_};
+  }
+
+ private:
+  static constexpr std::array<char, 8> kMagic{'R', 'T', 'F', 'I', 'L', 'M', '0', '3'};
+  static constexpr std::uint32_t kByteOrder{0x01020304};
+  static constexpr std::uint32_t kMaxSide{1U << 16U};  // larger headers are taken as corrupt
+  static constexpr std::uint32_t kMaxRanges{1U << 20U};
+
+  struct header {
+    std::array<char, 8> magic_{};  // NOLINT
+    std::uint32_t width_{};        // NOLINT
+    std::uint32_t height_{};       // NOLINT
+    std::uint32_t byte_order_{};   // NOLINT kByteOrder as the writer stores it
+    std::uint32_t tile_size_{};    // NOLINT
+    std::uint64_t scene_hash_{};   // NOLINT
+    std::uint32_t range_count_{};  // NOLINT
+    std::uint32_t reserved_{};     // NOLINT
+  };
+
+  struct record {
+    std::array<float, 3> rgb_{};  // NOLINT
+    std::uint32_t samples_{};     // NOLINT
+  };
+
+  int width_{};
+  int height_{};
+  std::vector<color> sum_{};
+  std::vector<std::uint32_t> samples_{};
+  std::uint32_t tile_size_{0};
+  std::vector<film_range> ranges_{};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+#include "vec3.h"
+
+namespace raytracer {
+
+// 64-bit FNV-1a, used to fingerprint scenes and camera settings
+class hasher {
+ public:
+  hasher& add(const std::uint64_t value) {
+    for (int byte = 0; byte < 8; byte++) {
+      state_ ^= (value >> static_cast<unsigned>(8 * byte)) & 0xffU;
+      state_ *= kPrime;
+    }
+    return *this;
+  }
+  hasher& add(const double value) {
+    return add(std::bit_cast<std::uint64_t>(value));
+  }
+  hasher& add(const int value) {
+    return add(static_cast<std::uint64_t>(value));
+  }
+  hasher& add(const vec3& value) {
+    return add(value.x()).add(value.y()).add(value.z());
+  }
+  hasher& add(const std::string_view value) {
+    for (const auto c : value) {
+      state_ ^= static_cast<unsigned char>(c);
+      state_ *= kPrime;
+    }
+    return *this;
+  }
+
+  [[nodiscard]] std::uint64_t value() const {
+    return state_;
+  }
+
+ private:
+  static constexpr std::uint64_t kOffset{0xcbf29ce484222325ULL};
+  static constexpr std::uint64_t kPrime{0x100000001b3ULL};
+  std::uint64_t state_{kOffset};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -1,19 +1,28 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include <cstdint>
+
+#include "aabb.h"
 #include "interval.h"
 #include "ray.h"
 
 namespace raytracer {
 
-class material;
+class hittable;
 
+// traversal only fills in t_, the primitive and material ids and the object that was hit (and
+// for instances the object inside), all plain values. point, normal and face are derived once
+// from those after the closest hit is known, see hittable::closest_hit
 struct hit_record {
-  point3 p_{};                            // NOLINT
-  vec3 normal_{};                         // NOLINT
-  std::shared_ptr<material> material_{};  // NOLINT
-  double t_{};                            // NOLINT
-  bool front_face_{};                     // NOLINT
+  real t_{};                            // NOLINT
+  std::uint32_t prim_id_{};             // NOLINT index of the primitive within object_
+  std::uint32_t material_id_{};         // NOLINT index into material_table
+  const hittable* object_{nullptr};     // NOLINT primitive or primitive set that was hit
+  const hittable* instanced_{nullptr};  // NOLINT object hit inside object_, if that is an instance
+  point3 p_{};                          // NOLINT
+  vec3 normal_{};                       // NOLINT
+  bool front_face_{};                   // NOLINT
 
   void set_face_normal(const ray& r, const vec3& outward_normal) {
     front_face_ = dot(r.direction(), outward_normal) < 0;
@@ -25,7 +34,38 @@ class hittable {
  public:
   virtual ~hittable() = default;
 
+  // record a hit closer than ray_t.max(), if there is one
+  // only t_, prim_id_, material_id_, object_ and instanced_ are written, and only when a hit is
+  // reported
   virtual bool hit(const ray& r, const interval& ray_t, hit_record& rec) const = 0;
+
+  // fill in the point, normal and face of a hit this object recorded
+  // aggregates forward hit() to their children and are never the object_ of a record
+  virtual void surface([[maybe_unused]] const ray& r, [[maybe_unused]] hit_record& rec) const {}
+
+  // closest hit with its surface attributes
+  bool closest_hit(const ray& r, const interval& ray_t, hit_record& rec) const {
+    if (!hit(r, ray_t, rec)) {
+      return false;
+    }
+    if (rec.object_ != nullptr) {
+      rec.object_->surface(r, rec);
+    }
+    return true;
+  }
+
+  // bounding box enclosing the object, used by acceleration structures
+  [[nodiscard]] virtual aabb bounding_box() const = 0;
+
+  // hash() of objects that do not fingerprint themselves, aggregates holding one return it too
+  static constexpr std::uint64_t kUnhashed{0};
+
+  // fingerprint of the geometry and materials, equal for identical scenes
+  // checkpoints only resume for scenes with a fingerprint, so objects defined outside this
+  // library keep working without one and their scenes just render from scratch
+  [[nodiscard]] virtual std::uint64_t hash() const {
+    return kUnhashed;
+  }
 };
 
 }  // namespace raytracer
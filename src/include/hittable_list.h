@@ -4,6 +4,8 @@
 #include <memory>
 #include <vector>
 
+#include "dispatch.h"
+#include "hash.h"
 #include "hittable.h"
 
 namespace raytracer {
@@ -17,28 +19,53 @@ class hittable_list : public hittable {
 
   void clear() {
     objects_.clear();
+    kinds_.clear();
+    bbox_ = aabb{};
   }
 
   void add(const std::shared_ptr<hittable>& obj) {
     objects_.push_back(obj);
+    kinds_.push_back(primitive_kind_of(*obj));
+    bbox_ = aabb{bbox_, obj->bounding_box()};
+  }
+
+  [[nodiscard]] const std::vector<std::shared_ptr<hittable>>& objects() const {
+    return objects_;
   }
 
   bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
-    hit_record tmp_rec{};
     bool hit_anything{false};
     auto closest_t{ray_t.max()};
-    for (const auto& obj : objects_) {
-      if (obj->hit(r, interval{ray_t.min(), closest_t}, tmp_rec)) {
+    for (std::size_t i = 0; i < objects_.size(); i++) {
+      // objects only write to rec when they report a hit, which is then the closest so far
+      if (dispatch_hit(kinds_[i], *objects_[i], r, interval{ray_t.min(), closest_t}, rec)) {
         hit_anything = true;
-        closest_t = tmp_rec.t_;
-        rec = tmp_rec;
+        closest_t = rec.t_;
       }
     }
     return hit_anything;
   }
 
+  [[nodiscard]] aabb bounding_box() const override {
+    return bbox_;
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    hasher h{};
+    for (const auto& obj : objects_) {
+      const auto child = obj->hash();
+      if (child == kUnhashed) {
+        return kUnhashed;
+      }
+      h.add(child);
+    }
+    return h.value();
+  }
+
  private:
   std::vector<std::shared_ptr<hittable>> objects_{};
+  std::vector<primitive_kind> kinds_{};  // tag of every object, see dispatch_hit
+  aabb bbox_{};
 };
 
 }  // namespace raytracer
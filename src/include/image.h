@@ -0,0 +1,146 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "color.h"
+
+namespace raytracer {
+
+enum class image_format : std::uint8_t {
+  kPPMText,    // P3, gamma corrected 8-bit ascii
+  kPPMBinary,  // P6, gamma corrected 8-bit binary
+  kPFM,        // PF, linear 32-bit float radiance
+};
+
+inline std::string_view image_extension(const image_format format) {
+  return format == image_format::kPFM ? "pfm" : "ppm";
+}
+
+inline std::string image_header(const image_format format, const int width, const int height) {
+  switch (format) {
+    case image_format::kPPMText:
+      return std::format("P3\n{} {}\n255\n", width, height);
+    case image_format::kPPMBinary:
+      return std::format("P6\n{} {}\n255\n", width, height);
+    case image_format::kPFM:
+      // a negative scale marks little endian samples
+      return std::format("PF\n{} {}\n{}\n", width, height,
+                         std::endian::native == std::endian::little ? "-1.0" : "1.0");
+  }
+  return {};
+}
+
+// pfm stores scanlines from the bottom of the image up
+inline bool rows_bottom_up(const image_format format) {
+  return format == image_format::kPFM;
+}
+
+// append the encoded pixels of whole rows to out, rows are given top to bottom
+// rows are emitted in file order, so for bottom-up formats the last row comes first
+inline void encode_rows(const image_format format, std::span<const color> rows, const int width,
+                        std::vector<char>& out) {
+  const auto count = static_cast<std::int64_t>(rows.size());
+  const auto height = count / width;
+  const auto base = static_cast<std::int64_t>(out.size());
+  switch (format) {
+    case image_format::kPPMText: {
+      out.reserve(out.size() + (rows.size() * 12));
+      for (const auto& pixel : rows) {
+        std::format_to(std::back_inserter(out), "{}\n", as_color(pixel));
+      }
+      break;
+    }
+    case image_format::kPPMBinary: {
+      out.resize(base + (3 * count));
+      auto* dst = reinterpret_cast<std::uint8_t*>(out.data() + base);
+      const auto& gamma = gamma_table::get();
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (std::int64_t p = 0; p < count; p++) {
+        dst[(3 * p) + 0] = gamma.quantize(rows[p].x());
+        dst[(3 * p) + 1] = gamma.quantize(rows[p].y());
+        dst[(3 * p) + 2] = gamma.quantize(rows[p].z());
+      }
+      break;
+    }
+    case image_format::kPFM: {
+      out.resize(base + (3 * count * static_cast<std::int64_t>(sizeof(float))));
+      auto* dst = out.data() + base;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (std::int64_t row = 0; row < height; row++) {
+        const auto src_row = height - 1 - row;
+        for (std::int64_t i = 0; i < width; i++) {
+          const auto& pixel = rows[(src_row * width) + i];
+          const std::array<float, 3> rgb{static_cast<float>(pixel.x()),
+                                         static_cast<float>(pixel.y()),
+                                         static_cast<float>(pixel.z())};
+          std::memcpy(dst + (((row * width) + i) * sizeof(rgb)), rgb.data(), sizeof(rgb));
+        }
+      }
+      break;
+    }
+  }
+}
+
+// throws std::runtime_error if the file cannot be opened or written
+inline void write_image(const std::string& path, const image_format format, const int width,
+                        const int height, std::span<const color> pixels) {
+  std::ofstream ofs(path, std::ios::trunc | std::ios::binary);
+  if (!ofs) {
+    throw std::runtime_error(std::format("{}: cannot open image for writing", path));
+  }
+  const auto header = image_header(format, width, height);
+  std::vector<char> file_buf{header.begin(), header.end()};
+  encode_rows(format, pixels, width, file_buf);
+  ofs.write(file_buf.data(), std::ssize(file_buf));
+  ofs.close();
+  if (!ofs) {
+    throw std::runtime_error(std::format("{}: cannot write image", path));
+  }
+}
+
+// 8-bit samples of a binary ppm
+struct ppm_image {
+  int width_{};                      // NOLINT
+  int height_{};                     // NOLINT
+  std::vector<std::uint8_t> rgb_{};  // NOLINT three per pixel, rows top to bottom
+};
+
+// the image of a binary ppm with 8-bit samples, as write_image writes them
+// nullopt if the file cannot be read or is in any other format
+inline std::optional<ppm_image> read_ppm(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::string magic{};
+  ppm_image image{};
+  int max_value{};
+  if (!(ifs >> magic >> image.width_ >> image.height_ >> max_value) || magic != "P6" ||
+      max_value != 255 || image.width_ <= 0 || image.height_ <= 0) {
+    return std::nullopt;
+  }
+  ifs.get();  // the one whitespace character ending the header
+  image.rgb_.resize(3 * static_cast<std::size_t>(image.width_) * image.height_);
+  if (!ifs.read(reinterpret_cast<char*>(image.rgb_.data()), std::ssize(image.rgb_))) {
+    return std::nullopt;
+  }
+  return image;
+}
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "aabb.h"
+#include "bvh_tree.h"
+#include "hash.h"
+#include "hittable.h"
+#include "material.h"
+#include "metrics.h"
+#include "timer.h"
+#include "transform.h"
+
+namespace raytracer {
+
+// shared geometry placed in the scene through an affine transform
+// rays are moved into the geometry's object space rather than the geometry into the scene, so
+// any number of instances share one copy of it. only the inverse transform is stored, which is
+// what every ray needs; the few hits that need the forward one invert it again
+// the geometry may be any hittable except one that contains instances itself
+class instance final : public hittable {
+ public:
+  static constexpr std::uint32_t kKeepMaterial{std::numeric_limits<std::uint32_t>::max()};
+
+  // `mat`, when given, replaces the materials of the geometry
+  instance(std::shared_ptr<const hittable> geometry, const transform& object_to_world,
+           const std::shared_ptr<material>& mat = nullptr)
+      : geometry_{std::move(geometry)},
+        world_to_object_{object_to_world.inverse()},
+        material_id_{mat ? material_table::add(mat) : kKeepMaterial} {}
+
+  bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
+    // t is the same in both spaces, since the transformed direction is not normalized
+    if (!geometry_->hit(world_to_object_.apply(r), ray_t, rec)) {
+      return false;
+    }
+    rec.instanced_ = rec.object_;
+    rec.object_ = this;
+    if (material_id_ != kKeepMaterial) {
+      rec.material_id_ = material_id_;
+    }
+    return true;
+  }
+
+  void surface(const ray& r, hit_record& rec) const override {
+    if (rec.instanced_ != nullptr) {
+      rec.instanced_->surface(world_to_object_.apply(r), rec);
+    }
+    const auto outward_normal = rec.front_face_ ? rec.normal_ : -rec.normal_;
+    rec.p_ = world_to_object_.inverse().point(rec.p_);
+    rec.set_face_normal(r, unit_vec(world_to_object_.transposed_vector(outward_normal)));
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return world_to_object_.inverse().bounds(geometry_->bounding_box());
+  }
+
+  // move the instance, a bvh over it has to be refit or rebuilt afterwards
+  void set_transform(const transform& object_to_world) {
+    world_to_object_ = object_to_world.inverse();
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    const auto geometry = geometry_->hash();
+    if (geometry == kUnhashed) {
+      return kUnhashed;
+    }
+    hasher h{};
+    h.add(geometry).add(world_to_object_.hash());
+    if (material_id_ != kKeepMaterial) {
+      h.add(material_table::get(material_id_).hash());
+    }
+    return h.value();
+  }
+
+ private:
+  std::shared_ptr<const hittable> geometry_;
+  transform world_to_object_;
+  std::uint32_t material_id_;
+};
+
+// top level of a two-level hierarchy: a bvh over instances, each holding its own geometry
+// (usually a bvh_node) in object space. instances are stored by value in leaf order, so a
+// scene of millions of them is one flat array. instances can be moved between frames of an
+// animation, the bvh then follows them by refitting its boxes and is only rebuilt once they
+// have moved so far that the refit tree became much slower than a fresh one
+class instance_bvh final : public hittable {
+ public:
+  // rebuild when the sah cost of the refit tree exceeds this multiple of the cost after a build
+  static constexpr double kMaxCostGrowth{1.5};
+
+  explicit instance_bvh(std::vector<instance> instances, const int max_leaf_size = 2)
+      : instances_{std::move(instances)}, max_leaf_size_{max_leaf_size} {
+    slot_of_.resize(instances_.size());
+    for (std::uint32_t i = 0; i < slot_of_.size(); i++) {
+      slot_of_[i] = i;
+    }
+    rebuild();
+  }
+
+  bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
+    return tree_.hit(r, ray_t,
+                     [&](const std::uint32_t first, const std::uint32_t count, real& closest) {
+                       bool hit_anything{false};
+                       for (auto i = first; i < first + count; i++) {
+                         if (instances_[i].hit(r, interval{ray_t.min(), closest}, rec)) {
+                           hit_anything = true;
+                           closest = rec.t_;
+                         }
+                       }
+                       return hit_anything;
+                     });
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return tree_.bounding_box();
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    hasher h{};
+    for (const auto& inst : instances_) {
+      const auto child = inst.hash();
+      if (child == kUnhashed) {
+        return kUnhashed;
+      }
+      h.add(child);
+    }
+    return h.value();
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    return instances_.size();
+  }
+
+  // move instance `index`, counted in the order the constructor was given the instances
+  // takes effect for rays after the next update()
+  void set_transform(const std::size_t index, const transform& object_to_world) {
+    instances_[slot_of_[index]].set_transform(object_to_world);
+  }
+
+  // bring the bvh up to date with moved instances: refit its boxes, or rebuild it when the refit
+  // tree costs more than max_growth times what it did after the last build. true if rebuilt
+  bool update(const double max_growth = kMaxCostGrowth) {
+    const utility::phase_timer phase{"instance bvh refit"};
+    tree_.refit(instance_bounds());
+    if (tree_.sah_cost() <= max_growth * build_cost_) {
+      return false;
+    }
+    rebuild();
+    return true;
+  }
+
+ private:
+  // bounds of the instances, in leaf order
+  [[nodiscard]] std::vector<aabb> instance_bounds() const {
+    std::vector<aabb> bounds(instances_.size());
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::size_t i = 0; i < instances_.size(); i++) {
+      bounds[i] = instances_[i].bounding_box();
+    }
+    return bounds;
+  }
+
+  // build the bvh from scratch and put the instances in its leaf order
+  void rebuild() {
+    utility::timer timer{};
+    const utility::phase_timer phase{"instance bvh build"};
+    std::vector<std::uint32_t> order{};
+    tree_ = bvh_tree::build_sah(instance_bounds(), max_leaf_size_, order);
+    build_cost_ = tree_.sah_cost();
+    std::vector<instance> sorted{};
+    sorted.reserve(instances_.size());
+    std::vector<std::uint32_t> new_slot(order.size());
+    for (std::uint32_t k = 0; k < order.size(); k++) {
+      sorted.push_back(std::move(instances_[order[k]]));
+      new_slot[order[k]] = k;
+    }
+    instances_ = std::move(sorted);
+    for (auto& slot : slot_of_) {
+      slot = new_slot[slot];
+    }
+    timer.report(std::format("[bvh]: sah build of {} instances into {} nodes done.",
+                             instances_.size(), tree_.nodes().size()));
+  }
+
+  std::vector<instance> instances_{};
+  std::vector<std::uint32_t> slot_of_{};  // leaf slot of every instance, by constructor order
+  bvh_tree tree_{};
+  double build_cost_{0};  // sah cost right after the last build
+  int max_leaf_size_;
+};
+
+}  // namespace raytracer
+
+#endif
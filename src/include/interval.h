@@ -8,24 +8,27 @@ namespace raytracer {
 class interval {
  public:
   constexpr interval() : min_{+infinite}, max_{-infinite} {}
-  constexpr interval(const double min, const double max) : min_{min}, max_{max} {}
+  constexpr interval(const real min, const real max) : min_{min}, max_{max} {}
+  // tightest interval enclosing both a and b
+  constexpr interval(const interval& a, const interval& b)
+      : min_{a.min_ <= b.min_ ? a.min_ : b.min_}, max_{a.max_ >= b.max_ ? a.max_ : b.max_} {}
 
-  [[nodiscard]] constexpr double size() const {
+  [[nodiscard]] constexpr real size() const {
     return max_ - min_;
   }
-  [[nodiscard]] constexpr bool contains(const double x) const {
+  [[nodiscard]] constexpr bool contains(const real x) const {
     return x >= min_ && x <= max_;
   }
-  [[nodiscard]] constexpr bool surround(const double x) const {
+  [[nodiscard]] constexpr bool surround(const real x) const {
     return x > min_ && x < max_;
   }
-  [[nodiscard]] constexpr double min() const {
+  [[nodiscard]] constexpr real min() const {
     return min_;
   }
-  [[nodiscard]] constexpr double max() const {
+  [[nodiscard]] constexpr real max() const {
     return max_;
   }
-  [[nodiscard]] constexpr double clamp(const double x) const {
+  [[nodiscard]] constexpr real clamp(const real x) const {
     if (x < min_) {
       return min_;
     }
@@ -34,10 +37,14 @@ class interval {
     }
     return x;
   }
+  [[nodiscard]] constexpr interval expand(const real delta) const {
+    const auto padding = delta / 2;
+    return interval{min_ - padding, max_ + padding};
+  }
 
  private:
-  double min_{};
-  double max_{};
+  real min_{};
+  real max_{};
 };
 
 constexpr interval empty{+infinite, -infinite}, universe{-infinite, +infinite};
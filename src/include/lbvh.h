@@ -0,0 +1,474 @@
+#ifndef LBVH_H
+#define LBVH_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "aabb.h"
+#include "bvh_tree.h"
+
+namespace raytracer {
+
+// linear bvh builder
+// primitives are sorted along a morton curve through their centroids, then every interior node
+// is emitted independently from the sorted codes (Karras 2012) and bounds are propagated bottom
+// up, so each phase is a parallel loop over primitives
+// optional treelet restructuring (Karras and Aila 2013) recovers most of the SAH tree quality
+class lbvh_builder {
+ public:
+  struct settings {
+    int morton_bits_{30};    // NOLINT 30 (10 bits per axis) or 63 (21 bits per axis)
+    int treelet_passes_{0};  // NOLINT rounds of treelet restructuring, 0 disables it
+    int max_leaf_size_{4};   // NOLINT subtrees up to this size may collapse into one leaf
+    int leaf_batch_{1};      // NOLINT primitives of a leaf intersected at the cost of one
+  };
+
+  static bvh_tree build(std::span<const aabb> bounds, const settings& opts,
+                        std::vector<std::uint32_t>& order) {
+    order.clear();
+    if (bounds.empty()) {
+      return bvh_tree{};
+    }
+    lbvh_builder builder{bounds, opts};
+    builder.sort_primitives();
+    builder.emit_hierarchy();
+    builder.compute_bounds();
+    for (int pass = 0; pass < opts.treelet_passes_; pass++) {
+      builder.restructure_treelets();
+    }
+    return builder.flatten(order);
+  }
+
+ private:
+  static constexpr std::uint32_t kNone{std::numeric_limits<std::uint32_t>::max()};
+  static constexpr int kTreeletLeaves{7};
+  static constexpr int kSortBlocks{64};
+  static constexpr int kRadixBits{8};
+  static constexpr int kRadixBuckets{1 << kRadixBits};
+
+  // node ids: interior nodes are [0, n - 1), the leaf of sorted primitive k is n - 1 + k
+  lbvh_builder(std::span<const aabb> bounds, const settings& opts)
+      : bounds_{bounds},
+        opts_{opts},
+        n_{static_cast<std::uint32_t>(bounds.size())},
+        left_(n_ - 1),
+        right_(n_ - 1),
+        parent_((2 * n_) - 1, kNone),
+        box_((2 * n_) - 1),
+        cost_((2 * n_) - 1),
+        prims_((2 * n_) - 1, 1) {}
+
+  [[nodiscard]] std::uint32_t leaf_id(const std::uint32_t k) const {
+    return n_ - 1 + k;
+  }
+  [[nodiscard]] bool is_leaf(const std::uint32_t id) const {
+    return id >= n_ - 1;
+  }
+
+  // spread the low 10 bits of v so two zero bits separate each of them
+  static std::uint64_t expand_bits_10(std::uint64_t v) {
+    v &= 0x3ffU;
+    v = (v | (v << 16U)) & 0x030000ffU;
+    v = (v | (v << 8U)) & 0x0300f00fU;
+    v = (v | (v << 4U)) & 0x030c30c3U;
+    v = (v | (v << 2U)) & 0x09249249U;
+    return v;
+  }
+
+  // spread the low 21 bits of v so two zero bits separate each of them
+  static std::uint64_t expand_bits_21(std::uint64_t v) {
+    v &= 0x1fffffU;
+    v = (v | (v << 32U)) & 0x1f00000000ffffULL;
+    v = (v | (v << 16U)) & 0x1f0000ff0000ffULL;
+    v = (v | (v << 8U)) & 0x100f00f00f00f00fULL;
+    v = (v | (v << 4U)) & 0x10c30c30c30c30c3ULL;
+    v = (v | (v << 2U)) & 0x1249249249249249ULL;
+    return v;
+  }
+
+  void sort_primitives() {
+    const bool wide = opts_.morton_bits_ > 30;
+    const int bits_per_axis = wide ? 21 : 10;
+    const auto cells = static_cast<double>(1U << static_cast<unsigned>(bits_per_axis));
+
+    aabb centroid_box{};
+    for (const auto& box : bounds_) {
+      const auto c = box.centroid();
+      centroid_box = aabb{centroid_box, aabb{c, c}};
+    }
+    std::array<double, 3> min{};
+    std::array<double, 3> scale{};
+    for (int axis = 0; axis < 3; axis++) {
+      const auto& extent = centroid_box.axis_interval(axis);
+      min[axis] = extent.min();
+      scale[axis] = extent.size() > 0 ? (cells - 1) / extent.size() : 0;
+    }
+
+    std::vector<std::uint64_t> codes(n_);
+    order_.resize(n_);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::uint32_t i = 0; i < n_; i++) {
+      const auto c = bounds_[i].centroid();
+      const auto qx = static_cast<std::uint64_t>((c.x() - min[0]) * scale[0]);
+      const auto qy = static_cast<std::uint64_t>((c.y() - min[1]) * scale[1]);
+      const auto qz = static_cast<std::uint64_t>((c.z() - min[2]) * scale[2]);
+      const auto expand = wide ? expand_bits_21 : expand_bits_10;
+      codes[i] = (expand(qx) << 2U) | (expand(qy) << 1U) | expand(qz);
+      order_[i] = i;
+    }
+    radix_sort(codes, wide ? 63 : 30);
+    codes_ = std::move(codes);
+  }
+
+  // parallel stable LSD radix sort of codes_ (and order_ alongside) by the low `bits` bits
+  // the keys are split into fixed blocks, every block builds its own histogram, and an exclusive
+  // scan over (bucket, block) gives each block a private output range per bucket
+  void radix_sort(std::vector<std::uint64_t>& codes, const int bits) {
+    std::vector<std::uint64_t> codes_tmp(n_);
+    std::vector<std::uint32_t> order_tmp(n_);
+    std::vector<std::array<std::uint32_t, kRadixBuckets>> offsets(kSortBlocks);
+    const auto block_size = (n_ + kSortBlocks - 1) / kSortBlocks;
+
+    for (int shift = 0; shift < bits; shift += kRadixBits) {
+      const auto digit = [shift](const std::uint64_t code) {
+        return static_cast<std::uint32_t>((code >> static_cast<unsigned>(shift)) &
+                                          (kRadixBuckets - 1));
+      };
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int b = 0; b < kSortBlocks; b++) {
+        auto& hist = offsets[b];
+        hist.fill(0);
+        const auto end = std::min(n_, (b + 1) * block_size);
+        for (auto i = b * block_size; i < end; i++) {
+          hist[digit(codes[i])]++;
+        }
+      }
+      std::uint32_t running{0};
+      for (int bucket = 0; bucket < kRadixBuckets; bucket++) {
+        for (int b = 0; b < kSortBlocks; b++) {
+          const auto count = offsets[b][bucket];
+          offsets[b][bucket] = running;
+          running += count;
+        }
+      }
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int b = 0; b < kSortBlocks; b++) {
+        auto& dst = offsets[b];
+        const auto end = std::min(n_, (b + 1) * block_size);
+        for (auto i = b * block_size; i < end; i++) {
+          const auto slot = dst[digit(codes[i])]++;
+          codes_tmp[slot] = codes[i];
+          order_tmp[slot] = order_[i];
+        }
+      }
+      codes.swap(codes_tmp);
+      order_.swap(order_tmp);
+    }
+  }
+
+  // length of the common prefix of sorted keys i and j, -1 outside the key range
+  // duplicate codes are disambiguated by their position, as if the index was appended to them
+  [[nodiscard]] int delta(const std::int64_t i, const std::int64_t j) const {
+    if (j < 0 || j >= static_cast<std::int64_t>(n_)) {
+      return -1;
+    }
+    const auto a = codes_[i];
+    const auto b = codes_[j];
+    if (a == b) {
+      return 64 + std::countl_zero(static_cast<std::uint64_t>(i ^ j));
+    }
+    return std::countl_zero(a ^ b);
+  }
+
+  void emit_hierarchy() {
+    const auto n = static_cast<std::int64_t>(n_);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::int64_t i = 0; i < n - 1; i++) {
+      // direction of the range covered by node i
+      const std::int64_t d = delta(i, i + 1) - delta(i, i - 1) > 0 ? 1 : -1;
+      // find the other end of the range with an exponential then a binary search
+      const auto delta_min = delta(i, i - d);
+      std::int64_t l_max{2};
+      while (delta(i, i + (l_max * d)) > delta_min) {
+        l_max *= 2;
+      }
+      std::int64_t l{0};
+      for (auto t = l_max / 2; t >= 1; t /= 2) {
+        if (delta(i, i + ((l + t) * d)) > delta_min) {
+          l += t;
+        }
+      }
+      const auto j = i + (l * d);
+      // find the split position, where the common prefix of the range grows
+      const auto delta_node = delta(i, j);
+      std::int64_t s{0};
+      std::int64_t t{l};
+      do {
+        t = (t + 1) / 2;
+        if (delta(i, i + ((s + t) * d)) > delta_node) {
+          s += t;
+        }
+      } while (t > 1);
+      const auto gamma = i + (s * d) + std::min<std::int64_t>(d, 0);
+
+      const auto left = static_cast<std::uint32_t>(
+          std::min(i, j) == gamma ? leaf_id(static_cast<std::uint32_t>(gamma)) : gamma);
+      const auto right =
+          static_cast<std::uint32_t>(std::max(i, j) == gamma + 1
+                                         ? leaf_id(static_cast<std::uint32_t>(gamma + 1))
+                                         : gamma + 1);
+      left_[i] = left;
+      right_[i] = right;
+      parent_[left] = static_cast<std::uint32_t>(i);
+      parent_[right] = static_cast<std::uint32_t>(i);
+    }
+  }
+
+  // call visit(node) for every interior node after both of its children were visited
+  // one thread walks up from every leaf, the first thread to reach a node stops there and the
+  // second one, which knows both subtrees are finished, carries on
+  template <typename Visit>
+  void bottom_up(Visit&& visit) {
+    std::vector<std::atomic<std::uint32_t>> arrivals(n_ - 1);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::uint32_t k = 0; k < n_; k++) {
+      auto node = parent_[leaf_id(k)];
+      while (node != kNone) {
+        if (arrivals[node].fetch_add(1, std::memory_order_acq_rel) == 0) {
+          break;
+        }
+        visit(node);
+        node = parent_[node];
+      }
+    }
+  }
+
+  void refresh(const std::uint32_t node) {
+    const auto l = left_[node];
+    const auto r = right_[node];
+    box_[node] = aabb{box_[l], box_[r]};
+    prims_[node] = prims_[l] + prims_[r];
+    cost_[node] = (bvh_tree::kTraversalCost * box_[node].surface_area()) + cost_[l] + cost_[r];
+  }
+
+  void compute_bounds() {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::uint32_t k = 0; k < n_; k++) {
+      const auto id = leaf_id(k);
+      box_[id] = bounds_[order_[k]];
+      cost_[id] = box_[id].surface_area();
+    }
+    if (n_ > 1) {
+      bottom_up([this](const std::uint32_t node) { refresh(node); });
+    }
+  }
+
+  void restructure_treelets() {
+    if (n_ <= 2) {
+      return;
+    }
+    bottom_up([this](const std::uint32_t node) {
+      // children may have been restructured, which changes the cost of this subtree
+      refresh(node);
+      if (prims_[node] >= kTreeletLeaves) {
+        restructure(node);
+      }
+    });
+  }
+
+  // rebuild the topology of the treelet rooted at `root` with the lowest SAH cost, keeping its
+  // leaves (which may be whole subtrees) and reusing its interior nodes
+  void restructure(const std::uint32_t root) {
+    std::array<std::uint32_t, kTreeletLeaves> leaves{};
+    std::array<std::uint32_t, kTreeletLeaves - 1> interior{};
+    int leaf_count{2};
+    int interior_count{1};
+    leaves[0] = left_[root];
+    leaves[1] = right_[root];
+    interior[0] = root;
+    // grow the treelet by opening the leaf with the largest surface area
+    while (leaf_count < kTreeletLeaves) {
+      int best{-1};
+      double best_area{-1};
+      for (int i = 0; i < leaf_count; i++) {
+        const auto area = box_[leaves[i]].surface_area();
+        if (!is_leaf(leaves[i]) && area > best_area) {
+          best = i;
+          best_area = area;
+        }
+      }
+      if (best < 0) {
+        break;
+      }
+      const auto opened = leaves[best];
+      interior[interior_count++] = opened;
+      leaves[best] = left_[opened];
+      leaves[leaf_count++] = right_[opened];
+    }
+    if (leaf_count < 3) {
+      return;
+    }
+
+    // optimal partition of every subset of treelet leaves, smallest subsets first
+    const auto subsets = 1U << static_cast<unsigned>(leaf_count);
+    std::array<double, 1U << kTreeletLeaves> area{};
+    std::array<double, 1U << kTreeletLeaves> cost{};
+    std::array<std::uint32_t, 1U << kTreeletLeaves> split{};
+    for (std::uint32_t s = 1; s < subsets; s++) {
+      aabb box{};
+      for (int i = 0; i < leaf_count; i++) {
+        if ((s & (1U << static_cast<unsigned>(i))) != 0) {
+          box = aabb{box, box_[leaves[i]]};
+        }
+      }
+      area[s] = box.surface_area();
+      if (std::has_single_bit(s)) {
+        cost[s] = cost_[leaves[std::countr_zero(s)]];
+        continue;
+      }
+      // every proper subset is numerically smaller than s, so its cost is already known
+      // only partitions holding the lowest bit are enumerated, the rest are their mirror images
+      const auto low = s & (~s + 1);
+      auto best_cost{infinite};
+      for (auto p = (s - 1) & s; p != 0; p = (p - 1) & s) {
+        if ((p & low) != 0) {
+          const auto c = cost[p] + cost[s ^ p];
+          if (c < best_cost) {
+            best_cost = c;
+            split[s] = p;
+          }
+        }
+      }
+      cost[s] = (bvh_tree::kTraversalCost * area[s]) + best_cost;
+    }
+    const auto full = subsets - 1;
+    if (cost[full] >= cost_[root] * (1 - 1e-9)) {
+      return;
+    }
+    int next_interior{1};
+    rebuild(root, full, leaves, interior, split, next_interior);
+  }
+
+  std::uint32_t rebuild(const std::uint32_t node, const std::uint32_t subset,
+                        const std::array<std::uint32_t, kTreeletLeaves>& leaves,
+                        const std::array<std::uint32_t, kTreeletLeaves - 1>& interior,
+                        const std::array<std::uint32_t, 1U << kTreeletLeaves>& split,
+                        int& next_interior) {
+    const auto part = split[subset];
+    const auto take = [&](const std::uint32_t s) {
+      if (std::has_single_bit(s)) {
+        return leaves[std::countr_zero(s)];
+      }
+      const auto child = interior[next_interior++];
+      return rebuild(child, s, leaves, interior, split, next_interior);
+    };
+    const auto l = take(part);
+    const auto r = take(subset ^ part);
+    left_[node] = l;
+    right_[node] = r;
+    parent_[l] = node;
+    parent_[r] = node;
+    refresh(node);
+    return node;
+  }
+
+  // lay the tree out as bvh_flat_nodes, with siblings adjacent and small subtrees whose SAH
+  // cost does not beat a single leaf collapsed
+  bvh_tree flatten(std::vector<std::uint32_t>& order) {
+    std::vector<bvh_flat_node> nodes{};
+    nodes.reserve(2 * n_);
+    order.reserve(n_);
+    nodes.emplace_back();
+    // pairs of (source node id, flat node index)
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{n_ == 1 ? leaf_id(0) : 0, 0}};
+    std::vector<std::uint32_t> gather{};
+    while (!stack.empty()) {
+      const auto [id, flat] = stack.back();
+      stack.pop_back();
+      nodes[flat].box_ = box_[id];
+      const auto batch = static_cast<std::uint32_t>(std::max(1, opts_.leaf_batch_));
+      const auto batches = static_cast<double>((prims_[id] + batch - 1) / batch);
+      const auto max_leaf =
+          static_cast<std::uint32_t>(std::clamp(opts_.max_leaf_size_, 1, bvh_tree::kMaxLeafSize));
+      const auto collapse =
+          prims_[id] <= max_leaf && batches * box_[id].surface_area() <= cost_[id];
+      if (is_leaf(id) || collapse) {
+        nodes[flat].offset_ = static_cast<std::uint32_t>(order.size());
+        nodes[flat].count_ = static_cast<std::uint16_t>(prims_[id]);
+        gather.assign(1, id);
+        while (!gather.empty()) {
+          const auto g = gather.back();
+          gather.pop_back();
+          if (is_leaf(g)) {
+            order.push_back(order_[g - (n_ - 1)]);
+          } else {
+            gather.push_back(right_[g]);
+            gather.push_back(left_[g]);
+          }
+        }
+        continue;
+      }
+      // the split axis is where the child centroids are farthest apart, and the child with the
+      // smaller centroid goes first, matching what bvh_tree::hit expects
+      auto l = left_[id];
+      auto r = right_[id];
+      const auto cl = box_[l].centroid();
+      const auto cr = box_[r].centroid();
+      const auto diff = cr - cl;
+      const std::array<double, 3> span{diff.x(), diff.y(), diff.z()};
+      int axis{0};
+      for (int a = 1; a < 3; a++) {
+        if (std::fabs(span[a]) > std::fabs(span[axis])) {
+          axis = a;
+        }
+      }
+      if (span[axis] < 0) {
+        std::swap(l, r);
+      }
+      const auto child = static_cast<std::uint32_t>(nodes.size());
+      nodes.emplace_back();
+      nodes.emplace_back();
+      nodes[flat].offset_ = child;
+      nodes[flat].axis_ = static_cast<std::uint8_t>(axis);
+      stack.emplace_back(r, child + 1);
+      stack.emplace_back(l, child);
+    }
+    return bvh_tree{std::move(nodes)};
+  }
+
+  std::span<const aabb> bounds_;
+  settings opts_;
+  std::uint32_t n_;
+  std::vector<std::uint64_t> codes_{};
+  std::vector<std::uint32_t> order_{};  // sorted position to primitive index
+  std::vector<std::uint32_t> left_;
+  std::vector<std::uint32_t> right_;
+  std::vector<std::uint32_t> parent_;
+  std::vector<aabb> box_;
+  std::vector<double> cost_;  // SAH cost of the subtree, in units of surface area
+  std::vector<std::uint32_t> prims_;
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace raytracer {
+
+// read-only memory mapping of a whole file
+// pages are read in on first touch, so opening a file costs the same whatever its size
+class mapped_file {
+ public:
+  // throws std::runtime_error if the file cannot be opened or mapped
+  explicit mapped_file(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(std::format("{}: cannot open file", path));
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      size_ = static_cast<std::size_t>(st.st_size);
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      throw std::runtime_error(std::format("{}: cannot map file", path));
+    }
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  mapped_file(mapped_file&& other) noexcept
+      : data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)} {}
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  ~mapped_file() {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+  }
+
+  // advise the kernel the file will be read front to back, so it reads ahead more
+  void sequential() const {
+    if (data_ != nullptr) {
+      ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+  }
+
+  [[nodiscard]] std::span<const std::byte> bytes() const {
+    return {static_cast<const std::byte*>(data_), size_};
+  }
+
+  [[nodiscard]] std::string_view text() const {
+    return {static_cast<const char*>(data_), size_};
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    return size_;
+  }
+
+ private:
+  void* data_{nullptr};
+  std::size_t size_{0};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -1,15 +1,49 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
 #include "color.h"
+#include "hash.h"
 #include "hittable.h"
+#include "metrics.h"
+#include "sampler.h"
 
 namespace raytracer {
 
+// built-in material types, used to group work by material
+enum class material_kind : std::uint8_t {
+  kLambertian,
+  kMetal,
+  kDielectric,
+  kCustom,  // materials defined outside this file
+};
+inline constexpr int kMaterialKinds{4};
+
 class material {
  public:
   virtual ~material() = default;
 
+  // the built-in kinds belong to the final classes below, see material_table::scatter
+  [[nodiscard]] virtual material_kind kind() const {
+    return material_kind::kCustom;
+  }
+
+  // fingerprint of the material type and parameters
+  [[nodiscard]] virtual std::uint64_t hash() const {
+    return hasher{}.add(static_cast<int>(kind())).value();
+  }
+
+  // color of the surface itself, as the denoiser's albedo buffer records it
+  [[nodiscard]] virtual color albedo() const {
+    return color{1, 1, 1};
+  }
+
   virtual bool scatter([[maybe_unused]] const ray& ray_in, [[maybe_unused]] const hit_record& rec,
                        [[maybe_unused]] color& attenuation, [[maybe_unused]] ray& scattered) const {
     return false;
@@ -17,13 +51,25 @@ class material {
 };
 
 // lambertian(diffuse) reflection material
-class lambertian : public material {
+class lambertian final : public material {
  public:
   explicit constexpr lambertian(const color& albedo) : albedo_{albedo} {}
 
+  [[nodiscard]] material_kind kind() const override {
+    return material_kind::kLambertian;
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    return hasher{}.add(static_cast<int>(kind())).add(albedo_).value();
+  }
+
+  [[nodiscard]] color albedo() const override {
+    return albedo_;
+  }
+
   bool scatter([[maybe_unused]] const ray& ray_in, const hit_record& rec, color& attenuation,
                ray& scattered) const override {
-    auto scatter_dir = rec.normal_ + random_unit_vector();
+    auto scatter_dir = rec.normal_ + sample_unit_vector();
     if (scatter_dir.near_zero()) {
       // if random unit vector is exactly opposite the normal vector
       scatter_dir = rec.normal_;
@@ -43,16 +89,29 @@ class lambertian : public material {
 };
 
 // mirrored reflection
-class metal : public material {
+class metal final : public material {
  public:
-  explicit constexpr metal(const color& albedo, const double fuzz)
+  explicit constexpr metal(const color& albedo, const real fuzz)
       : albedo_{albedo}, fuzz_{fuzz < 1 ? fuzz : 1} {}
+
+  [[nodiscard]] material_kind kind() const override {
+    return material_kind::kMetal;
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    return hasher{}.add(static_cast<int>(kind())).add(albedo_).add(fuzz_).value();
+  }
+
+  [[nodiscard]] color albedo() const override {
+    return albedo_;
+  }
+
   bool scatter(const ray& ray_in, const hit_record& rec, color& attenuation,
                ray& scattered) const override {
     // mirrored reflection
     vec3 reflected = reflect(ray_in.direction(), rec.normal_);
     // fuzz reflection
-    reflected = unit_vec(reflected) + (fuzz_ * random_unit_vector());
+    reflected = unit_vec(reflected) + (fuzz_ * sample_unit_vector());
     scattered = ray(rec.p_, reflected);
     attenuation = albedo_;
     // check if the scattered direction is in the same direction of normal direction
@@ -61,30 +120,39 @@ class metal : public material {
 
  private:
   color albedo_{};
-  double fuzz_{};
+  real fuzz_{};
 };
 
 // refraction
-class dielectric : public material {
+class dielectric final : public material {
  public:
-  explicit constexpr dielectric(const double refraction_index)
+  explicit constexpr dielectric(const real refraction_index)
       : relative_refractive_index_{refraction_index} {}
+
+  [[nodiscard]] material_kind kind() const override {
+    return material_kind::kDielectric;
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    return hasher{}.add(static_cast<int>(kind())).add(relative_refractive_index_).value();
+  }
+
   bool scatter(const ray& ray_in, const hit_record& rec, color& attenuation,
                ray& scattered) const override {
-    attenuation = color{1.0, 1.0, 1.0};
+    attenuation = color{1, 1, 1};
     // if rec.front_face_ is true, means that incident ray has opposite direction of normal.
     // since our refraction_index_ is current material's refractive index over
     // enclosing material's refractive index, so we need to reverse it
-    const double ri =
-        rec.front_face_ ? (1.0 / relative_refractive_index_) : relative_refractive_index_;
+    const real ri =
+        rec.front_face_ ? (1 / relative_refractive_index_) : relative_refractive_index_;
     const auto unit_incident = unit_vec(ray_in.direction());
 
-    const double cos_theta = std::fmin(dot(-unit_incident, rec.normal_), 1.0);
-    const double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
-    const bool cannot_refract = ri * sin_theta > 1.0;
+    const real cos_theta = std::fmin(dot(-unit_incident, rec.normal_), real{1});
+    const real sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+    const bool cannot_refract = ri * sin_theta > 1;
 
     vec3 dir{};
-    if (cannot_refract || reflectance(cos_theta, ri) > random_double()) {
+    if (cannot_refract || reflectance(cos_theta, ri) > sample_1d()) {
       // cann't refract, which is total internal reflection
       dir = reflect(unit_incident, rec.normal_);
     } else {
@@ -98,16 +166,99 @@ class dielectric : public material {
  private:
   // relative refraction index, which is the ratio of material's refractive index over the
   // refractive index of the enclosing material
-  double relative_refractive_index_{};
+  real relative_refractive_index_{};
 
   // Schlick Approximation
-  static double reflectance(const double cosine, const double relative_refractive_index) {
+  static real reflectance(const real cosine, const real relative_refractive_index) {
     auto r0 = (1 - relative_refractive_index) / (1 + relative_refractive_index);
     r0 = r0 * r0;
     return r0 + (1 - r0) * std::pow((1 - cosine), 5);
   }
 };
 
+// flat table of every material in use, primitives and hit records refer to them by index
+// materials are added while the scene is built and only read while rendering, so lookups take
+// no lock and touch no reference counts. the kind of every material is kept next to it, and
+// scatter() switches on it to call the final built-in classes directly, which the compiler can
+// inline. only custom materials go through the virtual call
+// scenes may be built from several threads at once, adds take a lock. adding while another
+// thread renders is not safe, as the tables may reallocate under the lookups. ids are never
+// reclaimed: the table keeps every material it was given alive until the process exits, so
+// long-running processes should build their scenes once and reuse them
+class material_table {
+ public:
+  // index of mat, adding it on first use
+  static std::uint32_t add(const std::shared_ptr<material>& mat) {
+    const std::scoped_lock lock{mutex_};
+    const auto [iter, inserted] =
+        index_.try_emplace(mat.get(), static_cast<std::uint32_t>(materials_.size()));
+    if (inserted) {
+      append(mat);
+    }
+    return iter->second;
+  }
+
+  // add mats under consecutive ids and return the first, for primitives that store ids
+  // relative to a base
+  static std::uint32_t add_block(std::span<const std::shared_ptr<material>> mats) {
+    const std::scoped_lock lock{mutex_};
+    const auto base = static_cast<std::uint32_t>(materials_.size());
+    for (const auto& mat : mats) {
+      // a material already in the table would keep its old id and break the block
+      index_.insert_or_assign(mat.get(), static_cast<std::uint32_t>(materials_.size()));
+      append(mat);
+    }
+    return base;
+  }
+
+  static const material& get(const std::uint32_t id) {
+    return *materials_[id];
+  }
+
+  [[nodiscard]] static material_kind kind(const std::uint32_t id) {
+    return kinds_[id];
+  }
+
+  static bool scatter(const std::uint32_t id, const ray& ray_in, const hit_record& rec,
+                      color& attenuation, ray& scattered) {
+    const auto* mat = materials_[id];
+    utility::metrics::count_scatter(static_cast<int>(kinds_[id]));
+    switch (kinds_[id]) {
+      case material_kind::kLambertian:
+        return static_cast<const lambertian*>(mat)->scatter(ray_in, rec, attenuation, scattered);
+      case material_kind::kMetal:
+        return static_cast<const metal*>(mat)->scatter(ray_in, rec, attenuation, scattered);
+      case material_kind::kDielectric:
+        return static_cast<const dielectric*>(mat)->scatter(ray_in, rec, attenuation, scattered);
+      case material_kind::kCustom:
+        break;
+    }
+    return mat->scatter(ray_in, rec, attenuation, scattered);
+  }
+
+  [[nodiscard]] static color albedo(const std::uint32_t id) {
+    return materials_[id]->albedo();
+  }
+
+  [[nodiscard]] static std::uint32_t size() {
+    const std::scoped_lock lock{mutex_};
+    return static_cast<std::uint32_t>(materials_.size());
+  }
+
+ private:
+  static void append(const std::shared_ptr<material>& mat) {
+    owners_.push_back(mat);
+    materials_.push_back(mat.get());
+    kinds_.push_back(mat->kind());
+  }
+
+  inline static std::mutex mutex_{};  // guards adds, lookups while rendering take no lock
+  inline static std::vector<const material*> materials_{};
+  inline static std::vector<material_kind> kinds_{};
+  inline static std::vector<std::shared_ptr<material>> owners_{};
+  inline static std::unordered_map<const material*, std::uint32_t> index_{};
+};
+
 }  // namespace raytracer
 
 #endif
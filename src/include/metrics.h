@@ -0,0 +1,291 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace raytracer::utility {
+
+// render counters of one thread, merged into totals when the report is written
+struct thread_counters {
+  static constexpr int kDepths{16};  // rays of depth kDepths - 1 and deeper share the last entry
+  static constexpr int kKinds{8};    // material kinds counted by scatter calls
+
+  std::array<std::uint64_t, kDepths> rays_{};     // NOLINT rays cast, by path depth
+  std::uint64_t box_tests_{};                     // NOLINT bvh node boxes tested
+  std::uint64_t primitive_tests_{};               // NOLINT ray/primitive intersection tests
+  std::array<std::uint64_t, kKinds> scatters_{};  // NOLINT scatter calls, by material kind
+
+  thread_counters& operator+=(const thread_counters& rhs) {
+    for (int d = 0; d < kDepths; d++) {
+      rays_[d] += rhs.rays_[d];
+    }
+    box_tests_ += rhs.box_tests_;
+    primitive_tests_ += rhs.primitive_tests_;
+    for (int k = 0; k < kKinds; k++) {
+      scatters_[k] += rhs.scatters_[k];
+    }
+    return *this;
+  }
+
+  [[nodiscard]] std::uint64_t rays() const {
+    std::uint64_t sum{0};
+    for (const auto n : rays_) {
+      sum += n;
+    }
+    return sum;
+  }
+};
+
+// process-wide registry of render metrics
+// every thread counts into a block of its own, so counting is a plain increment with no sharing;
+// blocks are summed only when totals are read, after the threads that wrote them have joined
+// or finished their scheduler run.
+// unless RAYTRACER_METRICS is defined every recording function is empty and the counting
+// compiles away
+class metrics {
+ public:
+#ifdef RAYTRACER_METRICS
+  static constexpr bool kEnabled{true};
+#else
+  static constexpr bool kEnabled{false};
+#endif
+
+  static void count_rays([[maybe_unused]] const int depth,
+                         [[maybe_unused]] const std::uint64_t n) {
+    if constexpr (kEnabled) {
+      local().rays_[std::min(depth, thread_counters::kDepths - 1)] += n;
+    }
+  }
+
+  static void count_box_tests([[maybe_unused]] const std::uint64_t n) {
+    if constexpr (kEnabled) {
+      local().box_tests_ += n;
+    }
+  }
+
+  static void count_primitive_tests([[maybe_unused]] const std::uint64_t n) {
+    if constexpr (kEnabled) {
+      local().primitive_tests_ += n;
+    }
+  }
+
+  static void count_scatter([[maybe_unused]] const int kind) {
+    if constexpr (kEnabled) {
+      local().scatters_[std::min(kind, thread_counters::kKinds - 1)]++;
+    }
+  }
+
+  // time a render worker spent on tasks and waiting, over one run of the scheduler
+  static void record_worker([[maybe_unused]] const int worker, [[maybe_unused]] const double busy,
+                            [[maybe_unused]] const double idle) {
+    if constexpr (kEnabled) {
+      const std::scoped_lock lock{mutex_};
+      if (workers_.size() <= static_cast<std::size_t>(worker)) {
+        workers_.resize(worker + 1);
+      }
+      workers_[worker].first += busy;
+      workers_[worker].second += idle;
+    }
+  }
+
+  static void record_phase([[maybe_unused]] const std::string_view name,
+                           [[maybe_unused]] const double seconds) {
+    if constexpr (kEnabled) {
+      const std::scoped_lock lock{mutex_};
+      phases_.emplace_back(name, seconds);
+    }
+  }
+
+  static thread_counters totals() {
+    const std::scoped_lock lock{mutex_};
+    thread_counters sum{};
+    for (const auto& block : blocks_) {
+      sum += block;
+    }
+    return sum;
+  }
+
+  // clear everything recorded so far, while no thread is counting
+  static void reset() {
+    const std::scoped_lock lock{mutex_};
+    for (auto& block : blocks_) {
+      block = thread_counters{};
+    }
+    workers_.clear();
+    phases_.clear();
+  }
+
+  // write the totals, per-worker times and phases as json, together with `summary` (numbers
+  // describing the render, such as its size and wall time). `kind_names` labels the scatter
+  // counts by material kind. does nothing when metrics are compiled out
+  static bool write_json([[maybe_unused]] const std::string& path,
+                         [[maybe_unused]] std::span<const std::pair<std::string, double>> summary,
+                         [[maybe_unused]] std::span<const std::string_view> kind_names) {
+    if constexpr (!kEnabled) {
+      return true;
+    }
+    const auto sum = totals();
+    const std::scoped_lock lock{mutex_};
+    const auto rays = sum.rays();
+    const auto per_ray = [&](const std::uint64_t n) {
+      return rays > 0 ? static_cast<double>(n) / static_cast<double>(rays) : 0.0;
+    };
+    std::string out{"{\n"};
+    for (const auto& [key, value] : summary) {
+      out += std::format("  \"{}\": {},\n", key, value);
+    }
+    out += std::format("  \"rays\": {},\n  \"rays_by_depth\": [", rays);
+    for (int d = 0; d < thread_counters::kDepths; d++) {
+      out += std::format("{}{}", d == 0 ? "" : ", ", sum.rays_[d]);
+    }
+    out += std::format(
+        "],\n  \"box_tests\": {},\n  \"box_tests_per_ray\": {:.3f},\n"
+        "  \"primitive_tests\": {},\n  \"primitive_tests_per_ray\": {:.3f},\n  \"scatters\": {{",
+        sum.box_tests_, per_ray(sum.box_tests_), sum.primitive_tests_,
+        per_ray(sum.primitive_tests_));
+    for (std::size_t k = 0; k < kind_names.size() && k < thread_counters::kKinds; k++) {
+      out += std::format("{}\"{}\": {}", k == 0 ? "" : ", ", kind_names[k], sum.scatters_[k]);
+    }
+    out += "},\n  \"workers\": [";
+    double busy_max{0};
+    double busy_sum{0};
+    for (std::size_t w = 0; w < workers_.size(); w++) {
+      const auto [busy, idle] = workers_[w];
+      busy_max = std::max(busy_max, busy);
+      busy_sum += busy;
+      out += std::format("{}{{\"busy_seconds\": {:.4f}, \"idle_seconds\": {:.4f}}}",
+                         w == 0 ? "" : ", ", busy, idle);
+    }
+    // slowest worker against the average one, 1 when the load is perfectly balanced
+    const auto imbalance =
+        busy_sum > 0 ? busy_max * static_cast<double>(workers_.size()) / busy_sum : 1.0;
+    out += std::format("],\n  \"imbalance\": {:.3f},\n  \"phases\": [", imbalance);
+    for (std::size_t p = 0; p < phases_.size(); p++) {
+      out += std::format("{}{{\"name\": \"{}\", \"seconds\": {:.4f}}}", p == 0 ? "" : ", ",
+                         phases_[p].first, phases_[p].second);
+    }
+    out += "]\n}\n";
+    std::ofstream ofs(path, std::ios::trunc);
+    ofs << out;
+    return static_cast<bool>(ofs);
+  }
+
+ private:
+  static thread_counters& local() {
+    thread_local thread_counters* block = [] {
+      const std::scoped_lock lock{mutex_};
+      return &blocks_.emplace_back();
+    }();
+    return *block;
+  }
+
+  inline static std::mutex mutex_{};
+  inline static std::deque<thread_counters> blocks_{};  // deque, so blocks never move
+  inline static std::vector<std::pair<double, double>> workers_{};  // busy and idle seconds
+  inline static std::vector<std::pair<std::string, double>> phases_{};
+};
+
+// records the time from construction to destruction as a named phase of the metrics report
+class phase_timer {
+ public:
+  explicit phase_timer([[maybe_unused]] const std::string_view name) {
+    if constexpr (metrics::kEnabled) {
+      name_ = name;
+      start_ = clock::now();
+    }
+  }
+
+  phase_timer(const phase_timer&) = delete;
+  phase_timer& operator=(const phase_timer&) = delete;
+
+  ~phase_timer() {
+    if constexpr (metrics::kEnabled) {
+      metrics::record_phase(name_, std::chrono::duration<double>(clock::now() - start_).count());
+    }
+  }
+
+ private:
+  using clock = std::chrono::steady_clock;
+  std::string_view name_{};
+  clock::time_point start_{};
+};
+
+// busy and idle time of every worker of one scheduler run, from the start of the run until the
+// last worker finished. a worker that runs out of tiles early is idle until then, so the idle
+// times show how evenly the run was shared out. wrap every task in a busy() scope
+class run_timer {
+  using clock = std::chrono::steady_clock;
+
+ public:
+  explicit run_timer([[maybe_unused]] const int workers) {
+    if constexpr (metrics::kEnabled) {
+      busy_.assign(static_cast<std::size_t>(workers), 0);
+      start_ = clock::now();
+    }
+  }
+
+  run_timer(const run_timer&) = delete;
+  run_timer& operator=(const run_timer&) = delete;
+
+  // the scheduler destroys it once every worker of the run is done
+  ~run_timer() {
+    if constexpr (metrics::kEnabled) {
+      const auto wall = std::chrono::duration<double>(clock::now() - start_).count();
+      for (std::size_t w = 0; w < busy_.size(); w++) {
+        metrics::record_worker(static_cast<int>(w), busy_[w], std::max(0.0, wall - busy_[w]));
+      }
+    }
+  }
+
+  // adds the time until the returned scope ends to the busy time of a worker
+  class busy_scope {
+   public:
+    explicit busy_scope(double* busy) : busy_{busy} {
+      if constexpr (metrics::kEnabled) {
+        start_ = clock::now();
+      }
+    }
+
+    busy_scope(const busy_scope&) = delete;
+    busy_scope& operator=(const busy_scope&) = delete;
+
+    ~busy_scope() {
+      if constexpr (metrics::kEnabled) {
+        *busy_ += std::chrono::duration<double>(clock::now() - start_).count();
+      }
+    }
+
+   private:
+    double* busy_;
+    clock::time_point start_{};
+  };
+
+  // every worker only touches its own entry, the run's end orders them before the destructor
+  [[nodiscard]] busy_scope busy([[maybe_unused]] const int worker) {
+    if constexpr (metrics::kEnabled) {
+      return busy_scope{&busy_[static_cast<std::size_t>(worker)]};
+    } else {
+      return busy_scope{nullptr};
+    }
+  }
+
+ private:
+  std::vector<double> busy_{};
+  clock::time_point start_{};
+};
+
+}  // namespace raytracer::utility
+
+#endif
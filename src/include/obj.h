@@ -0,0 +1,280 @@
+#ifndef OBJ_H
+#define OBJ_H
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bvh.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "metrics.h"
+#include "timer.h"
+#include "triangle_mesh.h"
+#include "vec3.h"
+
+namespace raytracer {
+
+// vertex positions and triangle indices read from an obj file
+struct mesh_data {
+  std::vector<point3> vertices_{};        // NOLINT
+  std::vector<std::uint32_t> indices_{};  // NOLINT three per triangle
+};
+
+// reader for the geometry of wavefront obj files
+// only `v` and `f` lines are used: polygons are split into triangle fans, texture coordinates,
+// normals, groups and materials are ignored. the file is memory-mapped and cut into chunks at
+// line breaks, which are parsed in parallel and then joined
+class obj_parser {
+ public:
+  // throws std::runtime_error for unreadable files and faces referring to missing vertices
+  static mesh_data load(const std::string& path) {
+    utility::timer timer{};
+    const utility::phase_timer phase{"obj load"};
+    const mapped_file file{path};
+    file.sequential();
+    const auto text = file.text();
+
+    // chunk boundaries, moved forward to the start of the next line
+    const auto chunk_count = std::max<std::size_t>(1, text.size() / kChunkBytes);
+    std::vector<std::size_t> starts(chunk_count + 1, text.size());
+    starts[0] = 0;
+    for (std::size_t k = 1; k < chunk_count; k++) {
+      const auto newline = text.find('\n', std::max(starts[k - 1], k * text.size() / chunk_count));
+      starts[k] = newline == std::string_view::npos ? text.size() : newline + 1;
+    }
+
+    std::vector<chunk> chunks(chunk_count);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t k = 0; k < chunk_count; k++) {
+      chunks[k].parse(text.substr(starts[k], starts[k + 1] - starts[k]));
+    }
+    for (std::size_t k = 0; k < chunk_count; k++) {
+      if (chunks[k].error_) {
+        throw std::runtime_error(
+            std::format("{}: malformed line at byte {}", path, starts[k] + *chunks[k].error_));
+      }
+    }
+
+    // negative indices count back from the vertices read so far, which depends on the chunks
+    // before, so they are resolved once every chunk's vertex count is known
+    std::vector<std::size_t> vertex_base(chunk_count + 1, 0);
+    std::vector<std::size_t> index_base(chunk_count + 1, 0);
+    for (std::size_t k = 0; k < chunk_count; k++) {
+      vertex_base[k + 1] = vertex_base[k] + chunks[k].vertices_.size();
+      index_base[k + 1] = index_base[k] + chunks[k].corners_.size();
+    }
+    const auto vertex_count = static_cast<std::int64_t>(vertex_base[chunk_count]);
+    mesh_data mesh{};
+    mesh.vertices_.resize(vertex_base[chunk_count]);
+    mesh.indices_.resize(index_base[chunk_count]);
+    std::vector<char> bad_index(chunk_count, 0);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (std::size_t k = 0; k < chunk_count; k++) {
+      auto& c = chunks[k];
+      std::ranges::copy(c.vertices_, mesh.vertices_.begin() + vertex_base[k]);
+      for (const auto pos : c.relative_) {
+        c.corners_[pos] += static_cast<std::int64_t>(vertex_base[k]);
+      }
+      for (std::size_t i = 0; i < c.corners_.size(); i++) {
+        const auto idx = c.corners_[i];
+        bad_index[k] |= static_cast<char>(idx < 0 || idx >= vertex_count);
+        mesh.indices_[index_base[k] + i] = static_cast<std::uint32_t>(idx);
+      }
+      c = chunk{};
+    }
+    if (std::ranges::any_of(bad_index, [](const char bad) { return bad != 0; })) {
+      throw std::runtime_error(std::format("{}: face refers to a missing vertex", path));
+    }
+    timer.report(std::format("[obj]: read {} vertices and {} triangles from {}",
+                             mesh.vertices_.size(), mesh.indices_.size() / 3, path));
+    return mesh;
+  }
+
+  // the obj file at path as one triangle_mesh with material mat
+  static std::shared_ptr<triangle_mesh> load_mesh(const std::string& path,
+                                                  const std::shared_ptr<material>& mat,
+                                                  const bvh_options& opts = {}) {
+    auto mesh = load(path);
+    return std::make_shared<triangle_mesh>(std::move(mesh.vertices_), mesh.indices_, mat, opts);
+  }
+
+ private:
+  static constexpr std::size_t kChunkBytes{std::size_t{1} << 22U};
+
+  // vertices and triangle corners of one chunk
+  // corners are zero-based global indices, except the ones listed in relative_, which are
+  // relative to the chunk's first vertex until load() adds its position in the file
+  struct chunk {
+    std::vector<point3> vertices_{};        // NOLINT
+    std::vector<std::int64_t> corners_{};   // NOLINT
+    std::vector<std::size_t> relative_{};   // NOLINT
+    std::optional<std::size_t> error_{};    // NOLINT offset of the first malformed line
+    std::vector<std::int64_t> polygon_{};   // NOLINT corners of the face being read
+    std::vector<bool> polygon_relative_{};  // NOLINT
+
+    void parse(const std::string_view text) {
+      std::size_t pos{0};
+      while (pos < text.size() && !error_) {
+        auto end = text.find('\n', pos);
+        if (end == std::string_view::npos) {
+          end = text.size();
+        }
+        if (!parse_line(text.substr(pos, end - pos))) {
+          error_ = pos;
+        }
+        pos = end + 1;
+      }
+    }
+
+    bool parse_line(const std::string_view line) {
+      const char* p = line.data();
+      const char* end = p + line.size();
+      skip_space(p, end);
+      if (end - p < 2 || !is_space(p[1])) {
+        return true;
+      }
+      if (p[0] == 'v') {
+        p++;
+        std::array<double, 3> xyz{};
+        for (auto& value : xyz) {
+          if (!parse_real(p, end, value)) {
+            return false;
+          }
+        }
+        vertices_.emplace_back(static_cast<real>(xyz[0]), static_cast<real>(xyz[1]),
+                               static_cast<real>(xyz[2]));
+        return true;
+      }
+      if (p[0] != 'f') {
+        return true;
+      }
+      p++;
+      polygon_.clear();
+      polygon_relative_.clear();
+      while (true) {
+        skip_space(p, end);
+        if (p == end || *p == '#') {
+          break;
+        }
+        std::int64_t index{};
+        const auto [next, ec] = std::from_chars(p, end, index);
+        if (ec != std::errc{} || index == 0) {
+          return false;
+        }
+        // skip the texture coordinate and normal indices of v/vt/vn
+        p = next;
+        while (p != end && !is_space(*p)) {
+          p++;
+        }
+        const auto relative = index < 0;
+        polygon_.push_back(relative ? static_cast<std::int64_t>(vertices_.size()) + index
+                                    : index - 1);
+        polygon_relative_.push_back(relative);
+      }
+      if (polygon_.size() < 3) {
+        return false;
+      }
+      for (std::size_t i = 1; i + 1 < polygon_.size(); i++) {
+        for (const auto corner : {std::size_t{0}, i, i + 1}) {
+          if (polygon_relative_[corner]) {
+            relative_.push_back(corners_.size());
+          }
+          corners_.push_back(polygon_[corner]);
+        }
+      }
+      return true;
+    }
+  };
+
+  static bool is_space(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  static void skip_space(const char*& p, const char* end) {
+    while (p != end && is_space(*p)) {
+      p++;
+    }
+  }
+
+  // decimal number with optional sign, fraction and exponent
+  // up to 19 significant digits are kept, which is more than double holds
+  static bool parse_real(const char*& p, const char* end, double& out) {
+    static constexpr std::array<double, 23> kPowers{
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    skip_space(p, end);
+    const auto negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) {
+      p++;
+    }
+    std::uint64_t mantissa{0};
+    int digits{0};
+    int exponent{0};
+    bool any{false};
+    const auto digit = [&](const bool fraction) {
+      const auto d = static_cast<std::uint64_t>(*p - '0');
+      if (digits < 19) {
+        mantissa = (mantissa * 10) + d;
+        digits += mantissa != 0 ? 1 : 0;
+        exponent -= fraction ? 1 : 0;
+      } else {
+        exponent += fraction ? 0 : 1;
+      }
+      any = true;
+      p++;
+    };
+    while (p != end && *p >= '0' && *p <= '9') {
+      digit(false);
+    }
+    if (p != end && *p == '.') {
+      p++;
+      while (p != end && *p >= '0' && *p <= '9') {
+        digit(true);
+      }
+    }
+    if (!any) {
+      return false;
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+      p++;
+      if (p != end && *p == '+') {
+        p++;
+      }
+      int e{};
+      const auto [next, ec] = std::from_chars(p, end, e);
+      if (ec != std::errc{}) {
+        return false;
+      }
+      exponent += e;
+      p = next;
+    }
+    auto value = static_cast<double>(mantissa);
+    if (exponent < 0 && -exponent < static_cast<int>(kPowers.size())) {
+      value /= kPowers[-exponent];
+    } else if (exponent >= 0 && exponent < static_cast<int>(kPowers.size())) {
+      value *= kPowers[exponent];
+    } else {
+      value *= std::pow(10.0, exponent);
+    }
+    out = negative ? -value : value;
+    return true;
+  }
+};
+
+}  // namespace raytracer
+
+#endif
@@ -15,7 +15,7 @@ class ray {
   [[nodiscard]] const vec3& direction() const {
     return dir_;
   }
-  [[nodiscard]] point3 at(const double t) const {
+  [[nodiscard]] point3 at(const real t) const {
     return ori_ + t * dir_;
   }
 
@@ -0,0 +1,93 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <span>
+
+namespace raytracer {
+
+// scrambles a 64-bit value so nearby inputs give unrelated outputs (splitmix64 finalizer)
+constexpr std::uint64_t mix64(std::uint64_t x) {
+  x ^= x >> 30U;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27U;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31U;
+  return x;
+}
+
+// pcg32 (o'neill, pcg-xsh-rr): 16 bytes of state, one multiply-add per 32 random bits
+// a generator is cheap to create, so every pixel sample gets its own independent stream and
+// results no longer depend on which thread traced it
+class pcg32 {
+ public:
+  constexpr pcg32() : pcg32{0, 0} {}
+  constexpr pcg32(const std::uint64_t seed, const std::uint64_t stream)
+      : inc_{(stream << 1U) | 1U} {
+    next_u32();
+    state_ += seed;
+    next_u32();
+  }
+
+  // the stream of sample `sample` of pixel `pixel` in a render seeded with `seed`
+  static constexpr pcg32 for_sample(const std::uint64_t pixel, const std::uint64_t sample,
+                                    const std::uint64_t seed = 0) {
+    return pcg32{mix64(seed ^ mix64(pixel)), mix64(sample + (pixel << 32U))};
+  }
+
+  constexpr std::uint32_t next_u32() {
+    const auto old = state_;
+    state_ = (old * kMultiplier) + inc_;
+    const auto xorshifted = static_cast<std::uint32_t>(((old >> 18U) ^ old) >> 27U);
+    const auto rot = static_cast<std::uint32_t>(old >> 59U);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31U));
+  }
+
+  // uniform double in [0,1) with 32 bits of resolution
+  constexpr double next_double() {
+    return next_u32() * kInvTwo32;
+  }
+
+  // fill out with uniform doubles in [0,1), the bulk form of next_double()
+  constexpr void fill(const std::span<double> out) {
+    for (auto& value : out) {
+      value = next_double();
+    }
+  }
+
+  // jump `delta` draws ahead in O(log delta) steps, so a dimension can be addressed directly
+  constexpr void advance(std::uint64_t delta) {
+    std::uint64_t acc_mult{1};
+    std::uint64_t acc_plus{0};
+    std::uint64_t cur_mult{kMultiplier};
+    std::uint64_t cur_plus{inc_};
+    while (delta > 0) {
+      if ((delta & 1U) != 0) {
+        acc_mult *= cur_mult;
+        acc_plus = (acc_plus * cur_mult) + cur_plus;
+      }
+      cur_plus = (cur_mult + 1) * cur_plus;
+      cur_mult *= cur_mult;
+      delta >>= 1U;
+    }
+    state_ = (acc_mult * state_) + acc_plus;
+  }
+
+ private:
+  static constexpr std::uint64_t kMultiplier{6364136223846793005ULL};
+  static constexpr double kInvTwo32{1.0 / 4294967296.0};
+
+  std::uint64_t state_{0};
+  std::uint64_t inc_{1};
+};
+
+// the generator random_double() draws from on this thread, for scene generation and benchmarks
+// renders do not use it: their sample values come from thread_sampler(), see sampler.h
+inline pcg32& thread_rng() {
+  thread_local pcg32 rng{};
+  return rng;
+}
+
+}  // namespace raytracer
+
+#endif
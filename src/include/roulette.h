@@ -0,0 +1,38 @@
+#ifndef ROULETTE_H
+#define ROULETTE_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "color.h"
+
+namespace raytracer {
+
+// counts of traced paths and of their segments (one ray cast each)
+struct path_stats {
+  std::uint64_t paths_{};     // NOLINT
+  std::uint64_t segments_{};  // NOLINT
+
+  path_stats& operator+=(const path_stats& rhs) {
+    paths_ += rhs.paths_;
+    segments_ += rhs.segments_;
+    return *this;
+  }
+
+  [[nodiscard]] double average_length() const {
+    return paths_ > 0 ? static_cast<double>(segments_) / static_cast<double>(paths_) : 0;
+  }
+};
+
+// chance that russian roulette lets a path with this throughput go on
+// paths that can still carry a lot of light almost always survive, dark ones usually end. the
+// floor bounds the weight 1 / p survivors are scaled by, which keeps the added variance small
+inline real survival_probability(const color& throughput) {
+  static constexpr real kMinSurvival{0.05};
+  return std::clamp(std::max({throughput.x(), throughput.y(), throughput.z()}), kMinSurvival,
+                    real{1});
+}
+
+}  // namespace raytracer
+
+#endif
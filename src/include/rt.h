@@ -3,23 +3,33 @@
 
 #include <limits>
 #include <numbers>
-#include <random>
+
+#include "rng.h"
 
 namespace raytracer {
 
-constexpr double infinite{std::numeric_limits<double>::infinity()};
-constexpr double pi{std::numbers::pi};
-constexpr std::size_t kMaxBufSize{64Z * 1024Z * 1024Z};
+// scalar of geometry, rays and colors, float when built with RAYTRACER_FLOAT
+// float halves the memory traffic of vectors and framebuffers and doubles the simd width
+#ifdef RAYTRACER_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
+constexpr real infinite{std::numeric_limits<real>::infinity()};
+constexpr real pi{std::numbers::pi_v<real>};
+
+// smallest distance at which rays accept hits, so a bounced ray does not hit the surface it
+// leaves from again because of rounding in the hit point
+constexpr real kRayEpsilon{sizeof(real) == sizeof(float) ? 1e-3 : 1e-5};
 
 inline double degrees2radians(const double degrees) {
-  return degrees * pi / 180.0;
+  return degrees * std::numbers::pi / 180.0;
 }
 
-// random double in [0,1)
+// random double in [0,1) from this thread's generator, see thread_rng()
 inline double random_double() {
-  thread_local std::uniform_real_distribution<double> dist(0.0, 1.0);
-  thread_local std::mt19937 gen(std::random_device{}());
-  return dist(gen);
+  return thread_rng().next_double();
 }
 
 inline double random_double(const double min, const double max) {
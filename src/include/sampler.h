@@ -0,0 +1,207 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "rng.h"
+#include "vec3.h"
+
+namespace raytracer {
+
+// how the sample values of a pixel are spread over each dimension
+enum class sampler_kind : std::uint8_t {
+  kIndependent,  // uniform random numbers
+  kStratified,   // one jittered stratum per sample, in a random order for every dimension
+  kSobol,        // owen-scrambled sobol points, padded to 2d with burley's shuffling
+};
+
+// values of one pixel sample, handed out a dimension (or a pair of dimensions) at a time
+// a sample consumes dimensions in a fixed order (pixel offset, lens, then whatever every bounce
+// draws), so its n-th value comes from the n-th dimension of the sampler's point set. the
+// dimensions are decorrelated by seeding each one with a hash of pixel, dimension and seed
+class sampler {
+ public:
+  sampler() = default;
+  sampler(const sampler_kind kind, const int samples_per_pixel, const std::uint64_t seed)
+      : kind_{kind}, samples_per_pixel_{samples_per_pixel}, seed_{seed} {}
+
+  [[nodiscard]] std::uint64_t seed() const {
+    return seed_;
+  }
+
+  // begin sample `sample` of pixel `pixel`
+  void start(const std::uint64_t pixel, const std::uint32_t sample) {
+    pixel_ = pixel;
+    sample_ = sample;
+    dimension_ = 0;
+    rng_ = pcg32::for_sample(pixel, sample, seed_);
+  }
+
+  double get_1d() {
+    const auto hash = dimension_hash();
+    switch (kind_) {
+      case sampler_kind::kStratified: {
+        const auto strata = static_cast<std::uint32_t>(samples_per_pixel_);
+        if (sample_ >= strata) {
+          break;
+        }
+        return (permute(sample_, strata, hash) + rng_.next_double()) / strata;
+      }
+      case sampler_kind::kSobol: {
+        const auto index = nested_uniform_scramble(sample_, hash);
+        return to_unit(nested_uniform_scramble(reverse_bits(index), hash_u32(hash)));
+      }
+      case sampler_kind::kIndependent:
+        break;
+    }
+    return rng_.next_double();
+  }
+
+  std::pair<double, double> get_2d() {
+    const auto hash = dimension_hash();
+    switch (kind_) {
+      case sampler_kind::kStratified: {
+        const auto side = static_cast<std::uint32_t>(std::sqrt(samples_per_pixel_));
+        if (sample_ >= side * side) {
+          break;
+        }
+        const auto cell = permute(sample_, side * side, hash);
+        const auto u = ((cell % side) + rng_.next_double()) / side;
+        return {u, ((cell / side) + rng_.next_double()) / side};
+      }
+      case sampler_kind::kSobol: {
+        const auto index = nested_uniform_scramble(sample_, hash);
+        const auto seed_x = hash_u32(hash);
+        const auto seed_y = hash_u32(seed_x);
+        return {to_unit(nested_uniform_scramble(reverse_bits(index), seed_x)),
+                to_unit(nested_uniform_scramble(sobol_second(index), seed_y))};
+      }
+      case sampler_kind::kIndependent:
+        break;
+    }
+    const auto u = rng_.next_double();
+    return {u, rng_.next_double()};
+  }
+
+ private:
+  static constexpr double to_unit(const std::uint32_t bits) {
+    return bits * (1.0 / 4294967296.0);
+  }
+
+  static constexpr std::uint32_t hash_u32(const std::uint32_t x) {
+    return static_cast<std::uint32_t>(mix64(x));
+  }
+
+  static constexpr std::uint32_t reverse_bits(std::uint32_t x) {
+    x = ((x >> 1U) & 0x55555555U) | ((x & 0x55555555U) << 1U);
+    x = ((x >> 2U) & 0x33333333U) | ((x & 0x33333333U) << 2U);
+    x = ((x >> 4U) & 0x0f0f0f0fU) | ((x & 0x0f0f0f0fU) << 4U);
+    x = ((x >> 8U) & 0x00ff00ffU) | ((x & 0x00ff00ffU) << 8U);
+    return (x >> 16U) | (x << 16U);
+  }
+
+  // second sobol dimension as a 32-bit fraction, the first one is reverse_bits(index)
+  static constexpr std::uint32_t sobol_second(std::uint32_t index) {
+    std::uint32_t result{0};
+    for (std::uint32_t v = 1U << 31U; index != 0; index >>= 1U, v ^= v >> 1U) {
+      if ((index & 1U) != 0) {
+        result ^= v;
+      }
+    }
+    return result;
+  }
+
+  // hash that only lets lower bits affect higher ones (burley 2020, after laine and karras)
+  static constexpr std::uint32_t laine_karras_permutation(std::uint32_t x,
+                                                          const std::uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cU;
+    x ^= x * 0xb82f1e52U;
+    x ^= x * 0xc7afe638U;
+    x ^= x * 0x8d22f6e6U;
+    return x;
+  }
+
+  // owen scrambling of a 32-bit fraction: a random permutation at every level of the binary tree
+  static constexpr std::uint32_t nested_uniform_scramble(std::uint32_t x,
+                                                         const std::uint32_t seed) {
+    x = reverse_bits(x);
+    x = laine_karras_permutation(x, seed);
+    return reverse_bits(x);
+  }
+
+  // random permutation of [0, n) evaluated at i (kensler 2013)
+  static constexpr std::uint32_t permute(std::uint32_t i, const std::uint32_t n,
+                                         const std::uint32_t p) {
+    auto w = n - 1;
+    w |= w >> 1U;
+    w |= w >> 2U;
+    w |= w >> 4U;
+    w |= w >> 8U;
+    w |= w >> 16U;
+    do {
+      i ^= p;
+      i *= 0xe170893dU;
+      i ^= p >> 16U;
+      i ^= (i & w) >> 4U;
+      i ^= p >> 8U;
+      i *= 0x0929eb3fU;
+      i ^= p >> 23U;
+      i ^= (i & w) >> 1U;
+      i *= 1U | (p >> 27U);
+      i *= 0x6935fa69U;
+      i ^= (i & w) >> 11U;
+      i *= 0x74dcb303U;
+      i ^= (i & w) >> 2U;
+      i *= 0x9e501cc3U;
+      i ^= (i & w) >> 2U;
+      i *= 0xc860a3dfU;
+      i &= w;
+      i ^= i >> 5U;
+    } while (i >= n);
+    return (i + p) % n;
+  }
+
+  // seed of the next dimension, the same for every sample of the pixel
+  std::uint32_t dimension_hash() {
+    return static_cast<std::uint32_t>(mix64(seed_ ^ mix64(pixel_ ^ mix64(dimension_++))));
+  }
+
+  sampler_kind kind_{sampler_kind::kIndependent};
+  int samples_per_pixel_{1};
+  std::uint64_t seed_{0};
+  std::uint64_t pixel_{0};
+  std::uint32_t sample_{0};
+  std::uint32_t dimension_{0};
+  pcg32 rng_{};
+};
+
+// the sampler of the sample this thread is tracing
+// renderers copy their configured sampler in and start() it before every sample
+inline sampler& thread_sampler() {
+  thread_local sampler s{};
+  return s;
+}
+
+// next dimension of this thread's sample in [0,1)
+inline double sample_1d() {
+  return thread_sampler().get_1d();
+}
+
+// uniform direction from the next two dimensions of this thread's sample
+inline vec3 sample_unit_vector() {
+  const auto [u, v] = thread_sampler().get_2d();
+  return square_to_sphere(u, v);
+}
+
+// point of the unit disk from the next two dimensions of this thread's sample
+inline vec3 sample_unit_disk() {
+  const auto [u, v] = thread_sampler().get_2d();
+  return square_to_disk(u, v);
+}
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+
+namespace raytracer {
+
+// built-in material with its parameters, the form materials are read and cached in
+struct material_record {
+  material_kind kind_{material_kind::kLambertian};  // NOLINT
+  std::array<real, 4> params_{};                    // NOLINT albedo and fuzz, or refraction index
+};
+
+inline std::shared_ptr<material> make_material(const material_record& rec) {
+  const auto& p = rec.params_;
+  switch (rec.kind_) {
+    case material_kind::kMetal:
+      return std::make_shared<metal>(color{p[0], p[1], p[2]}, p[3]);
+    case material_kind::kDielectric:
+      return std::make_shared<dielectric>(p[0]);
+    case material_kind::kLambertian:
+    case material_kind::kCustom:
+      break;
+  }
+  return std::make_shared<lambertian>(color{p[0], p[1], p[2]});
+}
+
+struct sphere_record {
+  point3 center_{};           // NOLINT
+  real radius_{};             // NOLINT
+  std::uint32_t material_{};  // NOLINT index into scene_description::materials_
+};
+
+// a scene and camera read from a scene file
+//
+// scene files are line based, `#` starts a comment:
+//   option <field> <values...>       any public field of options, without the trailing _
+//   material <name> lambertian <r> <g> <b>
+//   material <name> metal <r> <g> <b> <fuzz>
+//   material <name> dielectric <refraction index>
+//   sphere <x> <y> <z> <radius> <material name>
+struct scene_description {
+  options options_{};                         // NOLINT
+  std::vector<std::string> option_lines_{};   // NOLINT the option directives, as written
+  std::vector<material_record> materials_{};  // NOLINT
+  std::vector<sphere_record> spheres_{};      // NOLINT
+
+  // the scene as ordinary objects, for renders that do not use the binary cache
+  [[nodiscard]] hittable_list objects() const {
+    std::vector<std::shared_ptr<material>> mats{};
+    mats.reserve(materials_.size());
+    for (const auto& rec : materials_) {
+      mats.push_back(make_material(rec));
+    }
+    hittable_list list{};
+    for (const auto& s : spheres_) {
+      list.add(std::make_shared<sphere>(s.center_, s.radius_, mats[s.material_]));
+    }
+    return list;
+  }
+};
+
+// parse all of text as a number, false if it does not parse or has anything after the number
+// the command-line tools read their numeric flags with these
+inline bool parse_int(const std::string_view text, int& out) {
+  const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+  return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+inline bool parse_double(const std::string_view text, double& out) {
+  const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+  return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+class scene_parser {
+ public:
+  // throws std::runtime_error naming the file and line of the first error
+  static scene_description parse(std::istream& in, const std::string_view name) {
+    scene_description scene{};
+    std::unordered_map<std::string, std::uint32_t> material_ids{};
+    std::string line{};
+    int line_no{0};
+    while (std::getline(in, line)) {
+      line_no++;
+      const auto fail = [&](const std::string_view message) {
+        return std::runtime_error(std::format("{}:{}: {}", name, line_no, message));
+      };
+      if (const auto comment = line.find('#'); comment != std::string::npos) {
+        line.resize(comment);
+      }
+      std::istringstream args{line};
+      std::string keyword{};
+      if (!(args >> keyword)) {
+        continue;
+      }
+      if (keyword == "option") {
+        std::string field{};
+        args >> field;
+        if (!apply_option(scene.options_, field, args)) {
+          throw fail(std::format("bad value for option '{}'", field));
+        }
+        scene.option_lines_.push_back(line);
+      } else if (keyword == "material") {
+        std::string mat_name{};
+        std::string type{};
+        args >> mat_name >> type;
+        material_record rec{};
+        auto& p = rec.params_;
+        if (type == "lambertian") {
+          rec.kind_ = material_kind::kLambertian;
+          args >> p[0] >> p[1] >> p[2];
+        } else if (type == "metal") {
+          rec.kind_ = material_kind::kMetal;
+          args >> p[0] >> p[1] >> p[2] >> p[3];
+        } else if (type == "dielectric") {
+          rec.kind_ = material_kind::kDielectric;
+          args >> p[0];
+        } else {
+          throw fail(std::format("unknown material type '{}'", type));
+        }
+        if (!args) {
+          throw fail(std::format("bad parameters for material '{}'", mat_name));
+        }
+        material_ids[mat_name] = static_cast<std::uint32_t>(scene.materials_.size());
+        scene.materials_.push_back(rec);
+      } else if (keyword == "sphere") {
+        std::array<real, 4> v{};
+        std::string mat_name{};
+        args >> v[0] >> v[1] >> v[2] >> v[3] >> mat_name;
+        if (!args) {
+          throw fail("expected: sphere <x> <y> <z> <radius> <material>");
+        }
+        const auto iter = material_ids.find(mat_name);
+        if (iter == material_ids.end()) {
+          throw fail(std::format("unknown material '{}'", mat_name));
+        }
+        scene.spheres_.push_back(sphere_record{
+            .center_ = point3{v[0], v[1], v[2]}, .radius_ = v[3], .material_ = iter->second});
+      } else {
+        throw fail(std::format("unknown keyword '{}'", keyword));
+      }
+    }
+    return scene;
+  }
+
+  static scene_description load(const std::string& path) {
+    std::ifstream ifs{path};
+    if (!ifs) {
+      throw std::runtime_error(std::format("{}: cannot open scene file", path));
+    }
+    return parse(ifs, path);
+  }
+
+  // set the options field named `field` from the rest of the line, false if it does not parse
+  static bool apply_option(options& opts, const std::string_view field, std::istream& args) {
+    const auto vec = [&](vec3& out) {
+      real x{};
+      real y{};
+      real z{};
+      args >> x >> y >> z;
+      out = vec3{x, y, z};
+    };
+    const auto flag = [&](bool& out) {
+      std::string value{};
+      args >> value;
+      out = value == "true" || value == "1";
+      if (value != "true" && value != "false" && value != "1" && value != "0") {
+        args.setstate(std::ios::failbit);
+      }
+    };
+    std::string value{};
+    if (field == "aspect_ratio") {
+      args >> opts.aspect_ratio_;
+    } else if (field == "image_width") {
+      args >> opts.image_width_;
+    } else if (field == "samples_per_pixel") {
+      args >> opts.samples_per_pixel_;
+      if (opts.samples_per_pixel_ < 1) {
+        // a pixel without samples has no mean, and the renderers divide by the count
+        args.setstate(std::ios::failbit);
+      }
+    } else if (field == "max_depth") {
+      args >> opts.max_depth_;
+    } else if (field == "roulette_depth") {
+      args >> opts.roulette_depth_;
+    } else if (field == "vfov") {
+      args >> opts.vfov_;
+    } else if (field == "lookfrom") {
+      vec(opts.lookfrom_);
+    } else if (field == "lookat") {
+      vec(opts.lookat_);
+    } else if (field == "vup") {
+      vec(opts.vup_);
+    } else if (field == "defocus_angle") {
+      args >> opts.defocus_angle_;
+    } else if (field == "focus_dis") {
+      args >> opts.focus_dis_;
+    } else if (field == "seed") {
+      args >> opts.seed_;
+    } else if (field == "sampler") {
+      args >> value;
+      if (value == "independent") {
+        opts.sampler_ = sampler_kind::kIndependent;
+      } else if (value == "stratified") {
+        opts.sampler_ = sampler_kind::kStratified;
+      } else if (value == "sobol") {
+        opts.sampler_ = sampler_kind::kSobol;
+      } else {
+        return false;
+      }
+    } else if (field == "integrator") {
+      args >> value;
+      if (value == "recursive") {
+        opts.integrator_ = integrator::kRecursive;
+      } else if (value == "wavefront") {
+        opts.integrator_ = integrator::kWavefront;
+      } else {
+        return false;
+      }
+    } else if (field == "wavefront_size") {
+      args >> opts.wavefront_size_;
+    } else if (field == "tile_size") {
+      args >> opts.tile_size_;
+    } else if (field == "threads") {
+      args >> opts.threads_;
+    } else if (field == "output_format") {
+      args >> value;
+      if (value == "ppm_text") {
+        opts.output_format_ = image_format::kPPMText;
+      } else if (value == "ppm") {
+        opts.output_format_ = image_format::kPPMBinary;
+      } else if (value == "pfm") {
+        opts.output_format_ = image_format::kPFM;
+      } else {
+        return false;
+      }
+    } else if (field == "output_path") {
+      args >> opts.output_path_;
+    } else if (field == "streaming") {
+      flag(opts.streaming_);
+    } else if (field == "band_height") {
+      args >> opts.band_height_;
+    } else if (field == "max_inflight_bands") {
+      args >> opts.max_inflight_bands_;
+    } else if (field == "checkpoint_path") {
+      args >> opts.checkpoint_path_;
+    } else if (field == "checkpoint_interval") {
+      args >> opts.checkpoint_interval_;
+    } else if (field == "adaptive") {
+      flag(opts.adaptive_);
+    } else if (field == "adaptive_min_samples") {
+      args >> opts.adaptive_min_samples_;
+    } else if (field == "adaptive_max_samples") {
+      args >> opts.adaptive_max_samples_;
+    } else if (field == "adaptive_batch") {
+      args >> opts.adaptive_batch_;
+    } else if (field == "adaptive_error") {
+      args >> opts.adaptive_error_;
+    } else if (field == "sample_map_path") {
+      args >> opts.sample_map_path_;
+    } else if (field == "denoise") {
+      flag(opts.denoise_);
+    } else if (field == "denoise_iterations") {
+      args >> opts.denoise_iterations_;
+    } else if (field == "denoise_color_sigma") {
+      args >> opts.denoise_color_sigma_;
+    } else if (field == "denoise_normal_sigma") {
+      args >> opts.denoise_normal_sigma_;
+    } else if (field == "denoise_depth_sigma") {
+      args >> opts.denoise_depth_sigma_;
+    } else if (field == "write_aovs") {
+      flag(opts.write_aovs_);
+    } else if (field == "partial_path") {
+      args >> opts.partial_path_;
+    } else if (field == "tile_begin") {
+      args >> opts.tile_begin_;
+    } else if (field == "tile_end") {
+      args >> opts.tile_end_;
+    } else if (field == "sample_begin") {
+      args >> opts.sample_begin_;
+    } else if (field == "sample_end") {
+      args >> opts.sample_end_;
+    } else {
+      return false;
+    }
+    return !args.fail();
+  }
+};
+
+}  // namespace raytracer
+
+#endif
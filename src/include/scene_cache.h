@@ -0,0 +1,369 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bvh_tree.h"
+#include "hash.h"
+#include "hittable.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "metrics.h"
+#include "scene.h"
+#include "simd.h"
+#include "sphere_set.h"
+#include "timer.h"
+
+namespace raytracer {
+
+// compiled form of a scene file, laid out so it can be mapped and traced without parsing
+//
+// file layout, native endian and only valid for builds with the same real and simd width:
+//   header, then the sections it lists, each starting at a kAlignment boundary
+//   kOptions      the option directives of the scene file, one per line
+//   kMaterials    material_record per material
+//   kCenterX..    sphere_soa arrays in bvh leaf order, padded with simd::kWidth - 1 entries
+//   kNodes        bvh_flat_node per node, built with the same sah settings as bvh_node
+class scene_cache {
+ public:
+  enum section_id : std::uint8_t {
+    kOptions,
+    kMaterials,
+    kCenterX,
+    kCenterY,
+    kCenterZ,
+    kRadius,
+    kMaterialIds,
+    kNodes,
+    kSectionCount,
+  };
+
+  struct section {
+    std::uint64_t offset_{};  // NOLINT from the start of the file
+    std::uint64_t bytes_{};   // NOLINT
+  };
+
+  struct header {
+    std::array<char, 8> magic_{};                    // NOLINT
+    std::uint32_t real_size_{};                      // NOLINT sizeof(real) of the writer
+    std::uint32_t simd_width_{};                     // NOLINT padding of the sphere arrays
+    std::uint64_t source_key_{};                     // NOLINT see source_key()
+    std::uint32_t sphere_count_{};                   // NOLINT
+    std::uint32_t material_count_{};                 // NOLINT
+    std::uint32_t node_count_{};                     // NOLINT
+    std::uint32_t reserved_{};                       // NOLINT
+    std::array<section, kSectionCount> sections_{};  // NOLINT
+  };
+
+  static constexpr std::array<char, 8> kMagic{'R', 'T', 'S', 'C', 'E', 'N', 'E', '1'};
+  static constexpr std::uint64_t kAlignment{64};
+
+  // identifies the version of a scene file a cache was compiled from
+  // size and modification time, so checking a cache does not read the scene file
+  static std::uint64_t source_key(const std::string& path) {
+    const auto size = std::filesystem::file_size(path);
+    const auto mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+    return hasher{}
+        .add(static_cast<std::uint64_t>(size))
+        .add(static_cast<std::uint64_t>(mtime))
+        .value();
+  }
+
+  // write the compiled scene to path, through a temporary file renamed over it
+  // throws std::runtime_error when the file cannot be written
+  static void compile(const scene_description& scene, const std::uint64_t source_key,
+                      const std::string& path) {
+    utility::timer timer{};
+    const utility::phase_timer phase{"scene compile"};
+    const auto count = static_cast<std::uint32_t>(scene.spheres_.size());
+    std::vector<aabb> bounds(count);
+    for (std::uint32_t i = 0; i < count; i++) {
+      const auto& s = scene.spheres_[i];
+      const auto r = std::max(real{0}, s.radius_);
+      bounds[i] = aabb{s.center_ - vec3{r, r, r}, s.center_ + vec3{r, r, r}};
+    }
+    std::vector<std::uint32_t> order{};
+    const auto tree = bvh_tree::build_sah(bounds, std::max(4, simd::kWidth), order, simd::kWidth);
+
+    const auto padded = count + simd::kWidth - 1;
+    std::array<std::vector<real>, 4> soa{};
+    for (auto& array : soa) {
+      array.assign(padded, real{0});
+    }
+    std::vector<std::uint32_t> material_ids(padded, 0);
+    for (std::uint32_t slot = 0; slot < count; slot++) {
+      const auto& s = scene.spheres_[order[slot]];
+      soa[0][slot] = s.center_.x();
+      soa[1][slot] = s.center_.y();
+      soa[2][slot] = s.center_.z();
+      soa[3][slot] = std::max(real{0}, s.radius_);
+      material_ids[slot] = s.material_;
+    }
+    std::string option_text{};
+    for (const auto& line : scene.option_lines_) {
+      option_text += line;
+      option_text += '\n';
+    }
+
+    header head{.magic_ = kMagic,
+                .real_size_ = sizeof(real),
+                .simd_width_ = static_cast<std::uint32_t>(simd::kWidth),
+                .source_key_ = source_key,
+                .sphere_count_ = count,
+                .material_count_ = static_cast<std::uint32_t>(scene.materials_.size()),
+                .node_count_ = static_cast<std::uint32_t>(tree.nodes().size())};
+    const std::array<std::span<const std::byte>, kSectionCount> payloads{
+        std::as_bytes(std::span{option_text}),
+        std::as_bytes(std::span{scene.materials_}),
+        std::as_bytes(std::span{soa[0]}),
+        std::as_bytes(std::span{soa[1]}),
+        std::as_bytes(std::span{soa[2]}),
+        std::as_bytes(std::span{soa[3]}),
+        std::as_bytes(std::span{material_ids}),
+        std::as_bytes(std::span{tree.nodes()}),
+    };
+    auto offset = align(sizeof(header));
+    for (int id = 0; id < kSectionCount; id++) {
+      head.sections_[id] = section{.offset_ = offset, .bytes_ = payloads[id].size()};
+      offset = align(offset + payloads[id].size());
+    }
+
+    const auto tmp_path = path + ".tmp";
+    {
+      std::ofstream ofs(tmp_path, std::ios::trunc | std::ios::binary);
+      std::uint64_t written{0};
+      const auto write = [&](const std::span<const std::byte> bytes) {
+        ofs.write(reinterpret_cast<const char*>(bytes.data()),
+                  static_cast<std::streamsize>(bytes.size()));
+        written += bytes.size();
+      };
+      const auto pad_to = [&](const std::uint64_t target) {
+        static constexpr std::array<std::byte, kAlignment> kZeros{};
+        write(std::span{kZeros}.first(target - written));
+      };
+      write(std::as_bytes(std::span{&head, 1}));
+      for (int id = 0; id < kSectionCount; id++) {
+        pad_to(head.sections_[id].offset_);
+        write(payloads[id]);
+      }
+      if (!ofs) {
+        throw std::runtime_error(std::format("{}: cannot write scene cache", tmp_path));
+      }
+    }
+    std::filesystem::rename(tmp_path, path);
+    timer.report(std::format("[scene]: compiled {} spheres and {} materials into {}", count,
+                             scene.materials_.size(), path));
+  }
+
+  // the header of the cache at path, if it is a cache written by this build
+  // reads only the header, so a stale cache can be told apart without mapping it
+  static std::optional<header> peek_header(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    header head{};
+    if (!ifs.read(reinterpret_cast<char*>(&head), sizeof(head)) || head.magic_ != kMagic ||
+        head.real_size_ != sizeof(real) ||
+        head.simd_width_ != static_cast<std::uint32_t>(simd::kWidth)) {
+      return std::nullopt;
+    }
+    return head;
+  }
+
+ private:
+  static constexpr std::uint64_t align(const std::uint64_t offset) {
+    return (offset + kAlignment - 1) / kAlignment * kAlignment;
+  }
+};
+
+// scene traced straight out of a memory-mapped scene_cache file
+// primitives and bvh nodes are used in place, only the materials and options are read at startup
+class mapped_scene : public hittable {
+ public:
+  // throws std::runtime_error if the file cannot be mapped, was written by a different build or
+  // is corrupt
+  explicit mapped_scene(const std::string& path) : file_{path} {
+    utility::timer timer{};
+    const utility::phase_timer phase{"scene map"};
+    const auto fail = [&](const std::string_view message) {
+      return std::runtime_error(std::format("{}: {}", path, message));
+    };
+    const auto size = file_.size();
+    if (size < sizeof(scene_cache::header)) {
+      throw fail("truncated scene cache");
+    }
+    const auto* bytes = file_.bytes().data();
+    std::memcpy(&head_, bytes, sizeof(head_));
+    if (head_.magic_ != scene_cache::kMagic || head_.real_size_ != sizeof(real) ||
+        head_.simd_width_ != static_cast<std::uint32_t>(simd::kWidth)) {
+      throw fail("not a scene cache of this build");
+    }
+    for (const auto& sec : head_.sections_) {
+      if (sec.offset_ > size || sec.bytes_ > size - sec.offset_) {
+        throw fail("truncated scene cache");
+      }
+      if (sec.offset_ % scene_cache::kAlignment != 0) {
+        throw fail("misaligned section in scene cache");
+      }
+    }
+    const auto at = [&](const scene_cache::section_id id) {
+      return bytes + head_.sections_[id].offset_;
+    };
+
+    // every count in the header has to fit its section, and every index in the file has to
+    // stay within its array, before anything reads through them
+    const auto holds = [&](const scene_cache::section_id id, const std::uint64_t count,
+                           const std::uint64_t item_size) {
+      return head_.sections_[id].bytes_ / item_size >= count;
+    };
+    const auto padded = std::uint64_t{head_.sphere_count_} + simd::kWidth - 1;
+    if (!holds(scene_cache::kMaterials, head_.material_count_, sizeof(material_record)) ||
+        !holds(scene_cache::kCenterX, padded, sizeof(real)) ||
+        !holds(scene_cache::kCenterY, padded, sizeof(real)) ||
+        !holds(scene_cache::kCenterZ, padded, sizeof(real)) ||
+        !holds(scene_cache::kRadius, padded, sizeof(real)) ||
+        !holds(scene_cache::kMaterialIds, padded, sizeof(std::uint32_t)) ||
+        !holds(scene_cache::kNodes, head_.node_count_, sizeof(bvh_flat_node))) {
+      throw fail("scene cache sections are smaller than its counts");
+    }
+    const std::span material_ids{
+        reinterpret_cast<const std::uint32_t*>(at(scene_cache::kMaterialIds)),
+        head_.sphere_count_};
+    if (std::ranges::any_of(material_ids,
+                            [&](const std::uint32_t id) { return id >= head_.material_count_; })) {
+      throw fail("material index out of range in scene cache");
+    }
+    const std::span nodes{reinterpret_cast<const bvh_flat_node*>(at(scene_cache::kNodes)),
+                          head_.node_count_};
+    for (std::uint64_t n = 0; n < nodes.size(); n++) {
+      const auto& node = nodes[n];
+      // children follow their parent, which also rules out cycles
+      const auto valid =
+          node.count_ > 0
+              ? std::uint64_t{node.offset_} + node.count_ <= head_.sphere_count_
+              : node.offset_ > n && std::uint64_t{node.offset_} + 1 < nodes.size() &&
+                    node.axis_ < 3;
+      if (!valid) {
+        throw fail("bvh node out of range in scene cache");
+      }
+    }
+
+    std::istringstream option_lines{
+        std::string{reinterpret_cast<const char*>(at(scene_cache::kOptions)),
+                    head_.sections_[scene_cache::kOptions].bytes_}};
+    std::string line{};
+    while (std::getline(option_lines, line)) {
+      std::istringstream args{line};
+      std::string keyword{};
+      std::string field{};
+      args >> keyword >> field;
+      scene_parser::apply_option(options_, field, args);
+    }
+
+    const std::span materials{
+        reinterpret_cast<const material_record*>(at(scene_cache::kMaterials)),
+        head_.material_count_};
+    std::vector<std::shared_ptr<material>> mats{};
+    mats.reserve(materials.size());
+    for (const auto& rec : materials) {
+      mats.push_back(make_material(rec));
+    }
+    // one block, so scenes mapped from other threads cannot interleave their materials
+    const auto material_base = material_table::add_block(mats);
+
+    spheres_ = sphere_soa{
+        .cx_ = reinterpret_cast<const real*>(at(scene_cache::kCenterX)),
+        .cy_ = reinterpret_cast<const real*>(at(scene_cache::kCenterY)),
+        .cz_ = reinterpret_cast<const real*>(at(scene_cache::kCenterZ)),
+        .radius_ = reinterpret_cast<const real*>(at(scene_cache::kRadius)),
+        .material_ids_ = reinterpret_cast<const std::uint32_t*>(at(scene_cache::kMaterialIds)),
+        .count_ = head_.sphere_count_,
+        .material_base_ = material_base,
+        .owner_ = this};
+    nodes_ = nodes;
+    timer.report(std::format("[scene]: mapped {} spheres and {} nodes from {}",
+                             head_.sphere_count_, head_.node_count_, path));
+  }
+
+  mapped_scene(const mapped_scene&) = delete;
+  mapped_scene& operator=(const mapped_scene&) = delete;
+  mapped_scene(mapped_scene&&) = delete;
+  mapped_scene& operator=(mapped_scene&&) = delete;
+  ~mapped_scene() override = default;
+
+  // the compiled cache of the scene file at path, recompiled when missing or out of date
+  // paths ending in .rtb are taken to be caches already and mapped as they are
+  static std::unique_ptr<mapped_scene> open(const std::string& path) {
+    if (path.ends_with(".rtb")) {
+      return std::make_unique<mapped_scene>(path);
+    }
+    const auto cache_path = path + ".rtb";
+    const auto key = scene_cache::source_key(path);
+    // check the header first: mapping registers the cache's materials for good, which a stale
+    // cache must not do
+    if (const auto head = scene_cache::peek_header(cache_path); head && head->source_key_ == key) {
+      try {
+        return std::make_unique<mapped_scene>(cache_path);
+      } catch (const std::runtime_error&) {
+        // corrupt, compile it again below
+      }
+    }
+    scene_cache::compile(scene_parser::load(path), key, cache_path);
+    return std::make_unique<mapped_scene>(cache_path);
+  }
+
+  // options set by the scene file
+  [[nodiscard]] const options& scene_options() const {
+    return options_;
+  }
+
+  [[nodiscard]] std::uint64_t source_key() const {
+    return head_.source_key_;
+  }
+
+  bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
+    return bvh_tree::traverse(
+        nodes_, r, ray_t, [&](const std::uint32_t first, const std::uint32_t count, real& closest) {
+          if (spheres_.hit(r, interval{ray_t.min(), closest}, first, count, rec)) {
+            closest = rec.t_;
+            return true;
+          }
+          return false;
+        });
+  }
+
+  void surface(const ray& r, hit_record& rec) const override {
+    spheres_.surface(r, rec);
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return nodes_.empty() ? aabb{} : nodes_.front().box_;
+  }
+
+  // equal to the hash of a bvh_node built over the same spheres, so checkpoints carry over
+  [[nodiscard]] std::uint64_t hash() const override {
+    return spheres_.hash();
+  }
+
+ private:
+  mapped_file file_;
+  scene_cache::header head_{};
+  options options_{};
+  sphere_soa spheres_{};
+  std::span<const bvh_flat_node> nodes_{};
+};
+
+}  // namespace raytracer
+
+#endif
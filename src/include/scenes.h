@@ -0,0 +1,218 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "rt.h"
+#include "sphere.h"
+#include "vec3.h"
+
+namespace raytracer {
+
+// a world with the camera it is meant to be seen through
+struct scene_preset {
+  options opts_{};         // NOLINT
+  hittable_list world_{};  // NOLINT
+};
+
+// built-in scenes, generated from a seed so every build of one is identical
+// all of them draw from thread_rng(), which they reseed first
+class scenes {
+ public:
+  // the cover of ray tracing in one weekend: a grid of small random spheres around three big
+  // ones. seed 0 is the generator's initial state, the scene main() renders
+  static scene_preset random_spheres(const std::uint64_t seed = 0) {
+    thread_rng() = pcg32{seed, 0};
+    scene_preset scene{};
+    auto& opts = scene.opts_;
+    opts.aspect_ratio_ = 16.0 / 9.0;
+    opts.image_width_ = 1600;
+    opts.samples_per_pixel_ = 250;
+    opts.max_depth_ = 50;
+    opts.vfov_ = 25;
+    opts.lookfrom_ = vec3{11, 3, 8};
+    opts.lookat_ = vec3{0, 0, 0};
+    opts.vup_ = vec3{0, 1, 0};
+    opts.defocus_angle_ = 0.1;
+    opts.focus_dis_ = 12;
+
+    auto& world = scene.world_;
+    // ground
+    const auto ground_material = std::make_shared<lambertian>(color{0.5, 0.5, 0.5});
+    world.add(std::make_shared<sphere>(point3{0, -1000, 0}, 1000, ground_material));
+
+    // special sphere
+    constexpr int sphere_height{1};
+    constexpr int sphere_radius{1};
+    constexpr point3 special_point1{3.5, sphere_height, 0};  // mental
+    constexpr point3 special_point2{0, sphere_height, 0};    // dielectric
+    constexpr point3 special_point3{-4, sphere_height, 0};   // lambertian
+    constexpr point3 special_point4{0, sphere_height, 4};    // hollow glass
+    constexpr point3 special_point5{0, sphere_height, 4};    // hollow glass
+
+    constexpr int grid_x{16};
+    constexpr int grid_z{16};
+    constexpr double obj_r{0.2};
+
+    for (int a = -grid_x; a < grid_x; a++) {
+      for (int b = -grid_z; b < grid_z; b++) {
+        const auto random_material = random_double();
+        point3 center{static_cast<real>(a + 0.8 * random_double()), obj_r,
+                      static_cast<real>(b + 0.8 * random_double())};
+        if (clear_of(special_point1, center, sphere_radius + obj_r) &&
+            clear_of(special_point2, center, sphere_radius + obj_r) &&
+            clear_of(special_point3, center, sphere_radius + obj_r) &&
+            clear_of(special_point4, center, sphere_radius + obj_r)) {
+          std::shared_ptr<material> sphere_material{};
+          if (random_material < 0.7) {
+            // diffuse(even reflection)
+            const auto albedo = color::random();
+            sphere_material = std::make_shared<lambertian>(albedo);
+            world.add(std::make_shared<sphere>(center, obj_r, sphere_material));
+          } else if (random_material < 0.9) {
+            // metal(mirror reflection)
+            const auto albedo = color::random(0.5, 1);
+            const auto fuzz = random_double(0, 0.5);
+            sphere_material = std::make_shared<metal>(albedo, fuzz);
+            world.add(std::make_shared<sphere>(center, obj_r, sphere_material));
+          } else {
+            // glass(refraction or internal mirror reflection)
+            sphere_material = std::make_shared<dielectric>(1.5);
+            world.add(std::make_shared<sphere>(center, obj_r, sphere_material));
+          }
+        }
+      }
+    }
+
+    const auto material1 = std::make_shared<metal>(color{0.7, 0.6, 0.5}, 0.0);
+    world.add(std::make_shared<sphere>(special_point1, sphere_radius, material1));
+    const auto material2 = std::make_shared<dielectric>(1.5);
+    world.add(std::make_shared<sphere>(special_point2, sphere_radius, material2));
+    const auto material3 = std::make_shared<lambertian>(color{0.4, 0.2, 0.1});
+    world.add(std::make_shared<sphere>(special_point3, sphere_radius, material3));
+    const auto material4 = std::make_shared<dielectric>(1.5);
+    world.add(std::make_shared<sphere>(special_point4, sphere_radius, material4));
+    const auto material5 = std::make_shared<dielectric>(1 / 1.5);
+    world.add(std::make_shared<sphere>(special_point5, sphere_radius - 0.2, material5));
+    return scene;
+  }
+
+  // rows of touching glass spheres, every third one hollow, in front of coloured diffuse ones
+  // nearly every path refracts several times before it leaves the glass
+  static scene_preset dense_glass(const std::uint64_t seed = 1) {
+    thread_rng() = pcg32{seed, 0};
+    scene_preset scene{};
+    auto& opts = scene.opts_;
+    opts.max_depth_ = 50;
+    opts.vfov_ = 30;
+    opts.lookfrom_ = vec3{0, 4, 9};
+    opts.lookat_ = vec3{0, 0.5, 0};
+
+    auto& world = scene.world_;
+    world.add(std::make_shared<sphere>(point3{0, -1000, 0}, 1000,
+                                       std::make_shared<lambertian>(color{0.6, 0.6, 0.6})));
+    const auto glass = std::make_shared<dielectric>(1.5);
+    const auto bubble = std::make_shared<dielectric>(1 / 1.5);
+    constexpr int kRows{12};
+    constexpr real kRadius{0.5};
+    for (int a = 0; a < kRows; a++) {
+      for (int b = 0; b < kRows; b++) {
+        const point3 center{static_cast<real>((a - (kRows / 2) + 0.5) * 2 * kRadius), kRadius,
+                            static_cast<real>((b - (kRows / 2) + 0.5) * 2 * kRadius)};
+        if ((a + b) % 4 == 3) {
+          world.add(std::make_shared<sphere>(
+              center, kRadius, std::make_shared<lambertian>(color::random(0.2, 0.9))));
+          continue;
+        }
+        world.add(std::make_shared<sphere>(center, kRadius, glass));
+        if ((a + b) % 3 == 0) {
+          world.add(std::make_shared<sphere>(center, kRadius * 0.8, bubble));
+        }
+      }
+    }
+    return scene;
+  }
+
+  // `count` small random spheres resting on the ground, most of the time goes to traversal
+  static scene_preset many_spheres(const int count = 500000, const std::uint64_t seed = 2) {
+    thread_rng() = pcg32{seed, 0};
+    scene_preset scene{};
+    auto& opts = scene.opts_;
+    opts.max_depth_ = 20;
+    opts.vfov_ = 40;
+    opts.lookfrom_ = vec3{0, 30, 40};
+    opts.lookat_ = vec3{0, 0, -20};
+
+    auto& world = scene.world_;
+    constexpr double kGround{1000};
+    world.add(std::make_shared<sphere>(point3{0, -kGround, 0}, kGround,
+                                       std::make_shared<lambertian>(color{0.5, 0.5, 0.5})));
+    const std::array<std::shared_ptr<material>, 4> palette{
+        std::make_shared<lambertian>(color{0.8, 0.3, 0.3}),
+        std::make_shared<lambertian>(color{0.3, 0.8, 0.3}),
+        std::make_shared<metal>(color{0.8, 0.8, 0.9}, 0.1), std::make_shared<dielectric>(1.5)};
+    // four spheres per unit of area
+    const auto half = std::sqrt(count) * 0.25;
+    for (int n = 0; n < count; n++) {
+      const auto r = random_double(0.05, 0.2);
+      const auto x = random_double(-half, half);
+      const auto z = random_double(-half, half);
+      // on the curved ground, not floating above it far from the origin
+      const auto y = std::sqrt((kGround * kGround) - (x * x) - (z * z)) - kGround + r;
+      world.add(std::make_shared<sphere>(
+          point3{static_cast<real>(x), static_cast<real>(y), static_cast<real>(z)},
+          static_cast<real>(r), palette[n % palette.size()]));
+    }
+    return scene;
+  }
+
+  // a corridor of mirrors, on both sides and above, that reflect almost everything. light only
+  // comes in from the far ends, so paths bounce dozens of times before they find the sky.
+  // russian roulette is off to keep them long
+  static scene_preset deep_bounce(const std::uint64_t seed = 3) {
+    thread_rng() = pcg32{seed, 0};
+    scene_preset scene{};
+    auto& opts = scene.opts_;
+    opts.max_depth_ = 200;
+    opts.roulette_depth_ = opts.max_depth_;
+    opts.vfov_ = 60;
+    opts.lookfrom_ = vec3{-6, 1.5, 0.5};
+    opts.lookat_ = vec3{0, 1, 0};
+
+    auto& world = scene.world_;
+    constexpr real kFar{1000};
+    constexpr real kGap{3};
+    constexpr real kHeight{4};
+    const auto mirror = std::make_shared<metal>(color{0.97, 0.97, 0.97}, 0.0);
+    world.add(std::make_shared<sphere>(point3{0, 0, kFar + kGap}, kFar, mirror));
+    world.add(std::make_shared<sphere>(point3{0, 0, -(kFar + kGap)}, kFar, mirror));
+    world.add(std::make_shared<sphere>(point3{0, kFar + kHeight, 0}, kFar, mirror));
+    world.add(std::make_shared<sphere>(point3{0, -kFar, 0}, kFar,
+                                       std::make_shared<lambertian>(color{0.9, 0.9, 0.9})));
+    for (int n = 0; n < 5; n++) {
+      const point3 center{static_cast<real>(-2 + (n * 1.5)), 0.6,
+                          static_cast<real>(random_double(-1.5, 1.5))};
+      world.add(std::make_shared<sphere>(
+          center, 0.6,
+          n % 2 == 0 ? std::shared_ptr<material>{std::make_shared<dielectric>(1.5)}
+                     : std::shared_ptr<material>{
+                           std::make_shared<lambertian>(color::random(0.5, 0.95))}));
+    }
+    return scene;
+  }
+
+ private:
+  static bool clear_of(const point3& center, const point3& other, const double dis) {
+    return (center - other).length() > dis;
+  }
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "metrics.h"
+
+namespace raytracer {
+
+// rectangle of pixels [x0_, x1_) x [y0_, y1_)
+struct tile {
+  int x0_{};  // NOLINT
+  int y0_{};  // NOLINT
+  int x1_{};  // NOLINT
+  int y1_{};  // NOLINT
+
+  [[nodiscard]] int width() const {
+    return x1_ - x0_;
+  }
+  [[nodiscard]] int height() const {
+    return y1_ - y0_;
+  }
+};
+
+// position of the d-th cell along a hilbert curve covering an n x n grid, n a power of two
+inline std::pair<int, int> hilbert_d2xy(const int n, std::int64_t d) {
+  int x{0};
+  int y{0};
+  for (int s = 1; s < n; s *= 2) {
+    const auto rx = static_cast<int>(1 & (d / 2));
+    const auto ry = static_cast<int>(1 & (d ^ rx));
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      std::swap(x, y);
+    }
+    x += s * rx;
+    y += s * ry;
+    d /= 4;
+  }
+  return {x, y};
+}
+
+// split the image into tiles of at most tile_size x tile_size pixels, ordered along a hilbert
+// curve so consecutive tiles are neighbours on screen (and usually in the scene)
+inline std::vector<tile> make_tiles(const int width, const int height, const int tile_size) {
+  const auto size = std::max(1, tile_size);
+  const auto tiles_x = (width + size - 1) / size;
+  const auto tiles_y = (height + size - 1) / size;
+  int n{1};
+  while (n < tiles_x || n < tiles_y) {
+    n *= 2;
+  }
+  std::vector<tile> tiles{};
+  tiles.reserve(static_cast<std::size_t>(tiles_x) * tiles_y);
+  for (std::int64_t d = 0; d < static_cast<std::int64_t>(n) * n; d++) {
+    const auto [tx, ty] = hilbert_d2xy(n, d);
+    if (tx < tiles_x && ty < tiles_y) {
+      tiles.push_back(tile{.x0_ = tx * size,
+                           .y0_ = ty * size,
+                           .x1_ = std::min(width, (tx + 1) * size),
+                           .y1_ = std::min(height, (ty + 1) * size)});
+    }
+  }
+  return tiles;
+}
+
+// runs a task per tile on a pool of std::jthread workers with work stealing
+// every worker starts with a contiguous run of the curve-ordered tiles in its own deque and takes
+// them from the front, an idle worker steals from the back of another worker's deque, so
+// expensive regions get shared out while each worker mostly stays in one part of the image.
+// the workers live as long as the scheduler and sleep between runs, so rendering many frames
+// starts its threads once
+class tile_scheduler {
+ public:
+  // threads == 0 uses one worker per hardware thread
+  explicit tile_scheduler(const int threads)
+      : threads_{thread_count(threads)}, queues_(static_cast<std::size_t>(threads_)) {
+    workers_.reserve(threads_);
+    for (int w = 0; w < threads_; w++) {
+      workers_.emplace_back([this, w](const std::stop_token stop) { work(stop, w); });
+    }
+  }
+
+  tile_scheduler(const tile_scheduler&) = delete;
+  tile_scheduler& operator=(const tile_scheduler&) = delete;
+
+  // workers the scheduler starts for a requested number of threads
+  [[nodiscard]] static int thread_count(const int threads) {
+    return threads > 0 ? threads
+                       : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  [[nodiscard]] int threads() const {
+    return threads_;
+  }
+
+  // calls task(tile, worker) once for every tile and returns when all of them are done
+  // runs do not overlap, a run from a second thread waits for the first to finish
+  template <typename Task>
+  void run(std::span<const tile> tiles, Task&& task) {
+    if (tiles.empty()) {
+      return;
+    }
+    const std::scoped_lock serial{run_mutex_};
+    // idle time runs until the last worker is done, so the timer spans the whole run
+    utility::run_timer timer{threads_};
+    const auto per_worker = (tiles.size() + threads_ - 1) / threads_;
+    for (std::size_t i = 0; i < tiles.size(); i++) {
+      queues_[i / per_worker].tiles_.push_back(tiles[i]);
+    }
+    std::unique_lock lock{mutex_};
+    task_ = [&task](const tile& t, const int worker) { task(t, worker); };
+    timer_ = &timer;
+    running_ = threads_;
+    generation_++;
+    wake_.notify_all();
+    done_.wait(lock, [this] { return running_ == 0; });
+    task_ = nullptr;
+    timer_ = nullptr;
+  }
+
+ private:
+  struct worker_queue {
+    std::mutex mutex_{};        // NOLINT
+    std::deque<tile> tiles_{};  // NOLINT
+  };
+
+  // wait for a run, take part in it, and report back; until the scheduler is destroyed
+  void work(const std::stop_token stop, const int w) {
+    std::uint64_t seen{0};
+    while (true) {
+      {
+        std::unique_lock lock{mutex_};
+        if (!wake_.wait(lock, stop, [&] { return generation_ != seen; })) {
+          return;
+        }
+        seen = generation_;
+      }
+      while (const auto next = take(w)) {
+        const auto busy = timer_->busy(w);
+        task_(*next, w);
+      }
+      {
+        const std::scoped_lock lock{mutex_};
+        running_--;
+      }
+      done_.notify_one();
+    }
+  }
+
+  std::optional<tile> take(const int self) {
+    {
+      auto& own = queues_[self];
+      const std::scoped_lock lock{own.mutex_};
+      if (!own.tiles_.empty()) {
+        const auto next = own.tiles_.front();
+        own.tiles_.pop_front();
+        return next;
+      }
+    }
+    // no tasks are ever added, so once every deque is empty the work is done
+    for (int i = 1; i < threads_; i++) {
+      auto& victim = queues_[(self + i) % threads_];
+      const std::scoped_lock lock{victim.mutex_};
+      if (!victim.tiles_.empty()) {
+        const auto next = victim.tiles_.back();
+        victim.tiles_.pop_back();
+        return next;
+      }
+    }
+    return std::nullopt;
+  }
+
+  int threads_;
+  std::vector<worker_queue> queues_;
+  std::mutex run_mutex_{};
+  std::mutex mutex_{};
+  std::condition_variable_any wake_{};  // a run started, or the scheduler is going away
+  std::condition_variable done_{};      // the last worker of a run finished
+  std::function<void(const tile&, int)> task_{};
+  utility::run_timer* timer_{nullptr};  // busy times of the current run
+  std::uint64_t generation_{0};  // runs started so far
+  int running_{0};               // workers still busy with the current run
+  // last, so the workers stop and join before anything they use is destroyed
+  std::vector<std::jthread> workers_{};
+};
+
+}  // namespace raytracer
+
+#endif
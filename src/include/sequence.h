@@ -0,0 +1,161 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <mutex>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "color.h"
+#include "image.h"
+#include "instance.h"
+#include "timer.h"
+#include "transform.h"
+
+namespace raytracer {
+
+// what changes from one frame of an animation to the next
+struct frame_update {
+  options opts_{};  // NOLINT camera and output of the frame
+  // instances that moved, as their index in the instance_bvh and new object-to-world transform
+  std::vector<std::pair<std::size_t, transform>> transforms_{};  // NOLINT
+};
+
+// renders the frames of an animation over one scene and one set of render threads
+// every frame moves the instances it names and refits the instance bvh instead of building the
+// scene again, the camera keeps its worker pool between frames, and finished frames go to a
+// background writer so frame n is written while frame n + 1 traces. at most max_queued frames
+// wait for the writer, render() blocks beyond that
+class sequence_renderer {
+ public:
+  explicit sequence_renderer(instance_bvh& world, const int max_queued = 1)
+      : world_{world}, max_queued_{std::max(1, max_queued)} {
+    writer_ = std::jthread{[this] { write_frames(); }};
+  }
+
+  sequence_renderer(const sequence_renderer&) = delete;
+  sequence_renderer& operator=(const sequence_renderer&) = delete;
+
+  ~sequence_renderer() {
+    finish();
+  }
+
+  // render the next frame and queue it for writing to frame.opts_.output_path_, or to
+  // frame<number>.<ext> when that is empty
+  void render(const frame_update& frame) {
+    for (const auto& [index, object_to_world] : frame.transforms_) {
+      world_.set_transform(index, object_to_world);
+    }
+    if (!frame.transforms_.empty()) {
+      rebuilds_ += world_.update() ? 1 : 0;
+    }
+    camera_.set_options(frame.opts_);
+    auto pixels = camera_.render_pixels(world_);
+    timer_.report(std::format("[sequence]: frame {} traced.", frames_));
+
+    pending_frame out{.path_ = frame.opts_.output_path_.empty()
+                                   ? std::format("frame{:04}.{}", frames_,
+                                                 image_extension(frame.opts_.output_format_))
+                                   : frame.opts_.output_path_,
+                      .format_ = frame.opts_.output_format_,
+                      .width_ = frame.opts_.image_width_,
+                      .height_ = camera_.image_height(),
+                      .pixels_ = std::move(pixels)};
+    {
+      std::unique_lock lock{mutex_};
+      cv_.wait(lock, [this] { return std::ssize(queue_) < max_queued_; });
+      queue_.push_back(std::move(out));
+    }
+    cv_.notify_all();
+    frames_++;
+  }
+
+  // wait until every frame is written
+  void finish() {
+    {
+      const std::scoped_lock lock{mutex_};
+      if (done_) {
+        return;
+      }
+      done_ = true;
+    }
+    cv_.notify_all();
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+  }
+
+  [[nodiscard]] int frames() const {
+    return frames_;
+  }
+
+  // frames the writer could not write, valid after finish()
+  [[nodiscard]] int failed_frames() const {
+    return failed_;
+  }
+
+  // frames whose instance moves made the bvh rebuild rather than refit
+  [[nodiscard]] int rebuilds() const {
+    return rebuilds_;
+  }
+
+ private:
+  struct pending_frame {
+    std::string path_{};           // NOLINT
+    image_format format_{};        // NOLINT
+    int width_{};                  // NOLINT
+    int height_{};                 // NOLINT
+    std::vector<color> pixels_{};  // NOLINT
+  };
+
+  void write_frames() {
+    while (true) {
+      pending_frame frame{};
+      {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return !queue_.empty() || done_; });
+        if (queue_.empty()) {
+          return;
+        }
+        frame = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      // a slot is free as soon as the frame left the queue
+      cv_.notify_all();
+      try {
+        write_image(frame.path_, frame.format_, frame.width_, frame.height_, frame.pixels_);
+      } catch (const std::runtime_error& e) {
+        // later frames may still be written, finish() callers see the count
+        std::println(stderr, "{}", e.what());
+        failed_++;
+      }
+    }
+  }
+
+  instance_bvh& world_;
+  camera camera_{};
+  timer timer_{};
+  int frames_{0};
+  int rebuilds_{0};
+  int failed_{0};  // written by the writer thread only
+  int max_queued_;
+
+  std::mutex mutex_{};
+  std::condition_variable cv_{};
+  std::deque<pending_frame> queue_{};
+  bool done_{false};
+  std::jthread writer_{};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,486 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "camera.h"
+#include "hittable.h"
+#include "image.h"
+#include "scene.h"
+#include "timer.h"
+
+namespace raytracer {
+
+// address of the unix domain socket at path, throws std::runtime_error if the path is too long
+inline sockaddr_un socket_address(const std::string& path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error(std::format("{}: socket path too long", path));
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return addr;
+}
+
+// one end of a unix domain socket connection, read and written a line at a time
+class connection {
+ public:
+  explicit connection(const int fd) : fd_{fd} {}
+
+  connection(const connection&) = delete;
+  connection& operator=(const connection&) = delete;
+
+  ~connection() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  // connect to the server listening at path, throws std::runtime_error if there is none
+  static connection open(const std::string& path) {
+    const auto addr = socket_address(path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw std::runtime_error(std::format("{}: cannot connect to server", path));
+    }
+    return connection{fd};
+  }
+
+  // the next line without its newline, nullopt once the peer closed the connection
+  std::optional<std::string> read_line() {
+    while (true) {
+      if (const auto end = buffer_.find('\n'); end != std::string::npos) {
+        auto line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+        return line;
+      }
+      std::array<char, 4096> chunk{};
+      const auto n = ::read(fd_, chunk.data(), chunk.size());
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return std::nullopt;
+      }
+      buffer_.append(chunk.data(), static_cast<std::size_t>(n));
+    }
+  }
+
+  // false if the peer is gone, which does not raise SIGPIPE
+  bool write_line(const std::string_view line) {
+    std::string out{line};
+    out += '\n';
+    std::size_t done{0};
+    while (done < out.size()) {
+      const auto n = ::send(fd_, out.data() + done, out.size() - done, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      done += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  // wake reads and writes blocked on the connection, which then fail
+  void shutdown() const {
+    ::shutdown(fd_, SHUT_RDWR);
+  }
+
+ private:
+  int fd_;
+  std::string buffer_{};  // read but not yet returned
+};
+
+// unix domain socket accepting connections at a path, removed again on destruction
+class listener {
+ public:
+  // a socket left at path by a server that did not exit cleanly is replaced, anything else
+  // there is an error. throws std::runtime_error if the socket cannot be set up
+  explicit listener(std::string path) : path_{std::move(path)} {
+    const auto addr = socket_address(path_);
+    struct stat st{};
+    if (::lstat(path_.c_str(), &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+        throw std::runtime_error(std::format("{}: exists and is not a socket", path_));
+      }
+      ::unlink(path_.c_str());
+    }
+    // jobs choose the files they write, so only the owner may connect. nobody can connect
+    // before listen(), which closes the window between bind() and chmod()
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0 || ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::chmod(path_.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(fd_, SOMAXCONN) != 0) {
+      if (fd_ >= 0) {
+        ::close(fd_);
+      }
+      throw std::runtime_error(std::format("{}: cannot listen on socket", path_));
+    }
+  }
+
+  listener(const listener&) = delete;
+  listener& operator=(const listener&) = delete;
+
+  ~listener() {
+    ::close(fd_);
+    ::unlink(path_.c_str());
+  }
+
+  // the descriptor of the next connection, -1 once close() was called
+  [[nodiscard]] int accept() const {
+    while (true) {
+      const int fd = ::accept(fd_, nullptr, nullptr);
+      if (fd >= 0) {
+        return fd;
+      }
+      if (errno != EINTR && errno != ECONNABORTED) {
+        return -1;
+      }
+    }
+  }
+
+  // stop accepting, a blocked accept() returns
+  void close() const {
+    ::shutdown(fd_, SHUT_RDWR);
+  }
+
+ private:
+  std::string path_;
+  int fd_{-1};
+};
+
+// how a render job ended and where its time went
+struct job_result {
+  std::uint64_t id_{};       // NOLINT
+  bool cancelled_{false};    // NOLINT
+  std::string path_{};       // NOLINT image written, empty when cancelled
+  double queue_seconds_{};   // NOLINT from submission until the job started
+  double render_seconds_{};  // NOLINT
+  double write_seconds_{};   // NOLINT
+  std::string error_{};      // NOLINT why the job failed, empty unless it did
+};
+
+// renders many jobs against one scene loaded once
+// the world, its acceleration structures, the camera and the camera's worker pool are built
+// once and kept across jobs, a job only changes the camera options. jobs run one at a time on
+// every worker of the pool, which gives each its shortest latency, and the waiting job of the
+// highest priority goes next, in order of submission within a priority. a cancelled job is
+// dropped if it waits, and if it runs stops after its current tiles, or its current bounce with
+// the wavefront integrator
+//
+// clients talk to serve() over a unix domain socket, one request per connection:
+//   render [priority]            then option lines as in scene files, then a line `end`
+//                                replies `queued <id>`, and when the job ends either
+//                                `done <id> <path> queue <s> render <s> write <s>` or
+//                                `cancelled <id>`, or `failed <id> <message>` if it could not
+//                                render or write its image
+//   cancel <id>                  replies `cancelling <id>`, or `unknown <id>` if it has ended
+//   shutdown                     replies `ok`, cancels every job and makes serve() return
+// a bad request is answered with `error <message>`. a job writes its image with the server's
+// permissions to any output_path it names, which is why the socket is only open to its owner
+class render_server {
+ public:
+  // world has to outlive the server, jobs start from the options base
+  // every job uses base.threads_, so the pool is never rebuilt
+  render_server(const hittable& world, const options& base) : world_{world}, base_{base} {
+    renderer_ = std::jthread{[this](const std::stop_token stop) { run_jobs(stop); }};
+  }
+
+  render_server(const render_server&) = delete;
+  render_server& operator=(const render_server&) = delete;
+
+  ~render_server() {
+    stop();
+  }
+
+  [[nodiscard]] const options& base_options() const {
+    return base_;
+  }
+
+  // queue a render with opts, its id and the future of its result
+  std::pair<std::uint64_t, std::future<job_result>> submit(options opts, const int priority) {
+    opts.threads_ = base_.threads_;
+    auto next = std::make_unique<job>();
+    next->priority_ = priority;
+    next->opts_ = std::move(opts);
+    next->queued_at_ = clock::now();
+    auto result = next->result_.get_future();
+    std::uint64_t id{};
+    {
+      const std::scoped_lock lock{mutex_};
+      id = next_id_++;
+      next->id_ = id;
+      if (stopped_) {
+        next->result_.set_value(job_result{.id_ = id, .cancelled_ = true});
+        return {id, std::move(result)};
+      }
+      queue_.emplace(std::pair{-priority, id}, std::move(next));
+    }
+    cv_.notify_one();
+    return {id, std::move(result)};
+  }
+
+  // false if the job is not waiting or running
+  bool cancel(const std::uint64_t id) {
+    const std::scoped_lock lock{mutex_};
+    if (running_ != nullptr && running_->id_ == id) {
+      running_->stop_.request_stop();
+      return true;
+    }
+    // queues are short, a scan is fine
+    for (auto iter = queue_.begin(); iter != queue_.end(); ++iter) {
+      if (iter->second->id_ == id) {
+        iter->second->result_.set_value(job_result{.id_ = id, .cancelled_ = true});
+        queue_.erase(iter);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // cancel every job and wait for the render thread, later jobs are cancelled on submission
+  void stop() {
+    {
+      const std::scoped_lock lock{mutex_};
+      stopped_ = true;
+      for (auto& [key, waiting] : queue_) {
+        waiting->result_.set_value(job_result{.id_ = waiting->id_, .cancelled_ = true});
+      }
+      queue_.clear();
+      if (running_ != nullptr) {
+        running_->stop_.request_stop();
+      }
+    }
+    if (renderer_.joinable()) {
+      renderer_.request_stop();
+      renderer_.join();
+    }
+  }
+
+  // answer requests on the socket at path until a shutdown request, see the class comment
+  // every connection is served by its own thread, which waits for the job it submitted
+  // throws std::runtime_error if the socket cannot be set up
+  void serve(const std::string& path) {
+    listener socket{path};
+    {
+      const std::scoped_lock lock{mutex_};
+      listener_ = &socket;
+    }
+    timer_.report(std::format("[server]: listening on {}.", path));
+    // connection_ is closed after thread_ has been joined
+    struct client {
+      explicit client(const int fd) : connection_{fd} {}
+      connection connection_;
+      std::atomic<bool> done_{false};
+      std::jthread thread_{};
+    };
+    std::list<client> clients{};
+    for (int fd = socket.accept(); fd >= 0; fd = socket.accept()) {
+      clients.remove_if([](const client& c) { return c.done_.load(); });
+      auto& c = clients.emplace_back(fd);
+      c.thread_ = std::jthread{[this, &c] {
+        handle(c.connection_);
+        // clients read replies until the connection ends, which must not wait for the next
+        // accept to reap this client
+        c.connection_.shutdown();
+        c.done_ = true;
+      }};
+    }
+    // answer the clients waiting for jobs, then drop the ones still sending requests
+    stop();
+    {
+      const std::scoped_lock lock{mutex_};
+      listener_ = nullptr;
+    }
+    for (auto& c : clients) {
+      if (!c.done_) {
+        c.connection_.shutdown();
+      }
+    }
+    clients.clear();
+    timer_.report("[server]: stopped.");
+  }
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  struct job {
+    std::uint64_t id_{};                 // NOLINT
+    int priority_{};                     // NOLINT
+    options opts_{};                     // NOLINT
+    clock::time_point queued_at_{};      // NOLINT
+    std::stop_source stop_{};            // NOLINT requested by cancel()
+    std::promise<job_result> result_{};  // NOLINT
+  };
+
+  static double seconds(const clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+  }
+
+  // take the next job until the server stops
+  void run_jobs(const std::stop_token stop) {
+    while (true) {
+      std::unique_ptr<job> next{};
+      {
+        std::unique_lock lock{mutex_};
+        if (!cv_.wait(lock, stop, [this] { return !queue_.empty(); })) {
+          return;
+        }
+        next = std::move(queue_.begin()->second);
+        queue_.erase(queue_.begin());
+        running_ = next.get();
+      }
+      job_result result{.id_ = next->id_};
+      // an exception must not escape the render thread, the client hears of it instead
+      try {
+        result = render(*next);
+      } catch (const std::exception& e) {
+        result.error_ = e.what();
+        timer_.report(std::format("[server]: job {} failed: {}", next->id_, result.error_));
+      }
+      {
+        const std::scoped_lock lock{mutex_};
+        running_ = nullptr;
+      }
+      next->result_.set_value(std::move(result));
+    }
+  }
+
+  job_result render(job& j) {
+    job_result result{.id_ = j.id_};
+    const auto start = clock::now();
+    result.queue_seconds_ = seconds(start - j.queued_at_);
+    camera_.set_options(j.opts_);
+    camera_.set_stop_token(j.stop_.get_token());
+    const auto pixels = camera_.render_pixels(world_);
+    const auto traced = clock::now();
+    result.render_seconds_ = seconds(traced - start);
+    if (j.stop_.stop_requested()) {
+      result.cancelled_ = true;
+      timer_.report(std::format("[server]: job {} cancelled after {:.4f}s.", j.id_,
+                                result.render_seconds_));
+      return result;
+    }
+    result.path_ = j.opts_.output_path_.empty()
+                       ? std::format("job{}.{}", j.id_, image_extension(j.opts_.output_format_))
+                       : j.opts_.output_path_;
+    write_image(result.path_, j.opts_.output_format_, j.opts_.image_width_,
+                camera_.image_height(), pixels);
+    result.write_seconds_ = seconds(clock::now() - traced);
+    timer_.report(std::format(
+        "[server]: job {} written to {}, {:.4f}s queued, {:.4f}s rendering, {:.4f}s writing.",
+        j.id_, result.path_, result.queue_seconds_, result.render_seconds_,
+        result.write_seconds_));
+    return result;
+  }
+
+  // one request, see the class comment
+  void handle(connection& conn) {
+    const auto request = conn.read_line();
+    if (!request) {
+      return;
+    }
+    std::istringstream args{*request};
+    std::string command{};
+    args >> command;
+    if (command == "render") {
+      int priority{0};
+      args >> priority;  // optional, 0 when left out
+      auto opts = base_;
+      auto line = conn.read_line();
+      for (; line && *line != "end"; line = conn.read_line()) {
+        std::istringstream option{*line};
+        std::string keyword{};
+        std::string field{};
+        option >> keyword >> field;
+        if (keyword != "option" || !scene_parser::apply_option(opts, field, option)) {
+          conn.write_line(std::format("error bad option line '{}'", *line));
+          return;
+        }
+      }
+      if (!line) {
+        return;  // the client went away before the request was complete
+      }
+      auto [id, future] = submit(std::move(opts), priority);
+      conn.write_line(std::format("queued {}", id));
+      // a client that disconnects does not cancel its job
+      const auto result = future.get();
+      if (result.cancelled_) {
+        conn.write_line(std::format("cancelled {}", id));
+      } else if (!result.error_.empty()) {
+        conn.write_line(std::format("failed {} {}", id, result.error_));
+      } else {
+        conn.write_line(std::format("done {} {} queue {:.4f} render {:.4f} write {:.4f}", id,
+                                    result.path_, result.queue_seconds_, result.render_seconds_,
+                                    result.write_seconds_));
+      }
+    } else if (command == "cancel") {
+      std::uint64_t id{};
+      if (!(args >> id)) {
+        conn.write_line("error expected: cancel <id>");
+        return;
+      }
+      conn.write_line(cancel(id) ? std::format("cancelling {}", id)
+                                 : std::format("unknown {}", id));
+    } else if (command == "shutdown") {
+      conn.write_line("ok");
+      const std::scoped_lock lock{mutex_};
+      if (listener_ != nullptr) {
+        listener_->close();
+      }
+    } else {
+      conn.write_line(std::format("error unknown request '{}'", command));
+    }
+  }
+
+  const hittable& world_;
+  options base_;
+  camera camera_{};  // only used by the render thread
+  timer timer_{};
+
+  std::mutex mutex_{};
+  std::condition_variable_any cv_{};  // a job was queued
+  // waiting jobs by descending priority, then by id
+  std::map<std::pair<int, std::uint64_t>, std::unique_ptr<job>> queue_{};
+  job* running_{nullptr};
+  std::uint64_t next_id_{1};
+  bool stopped_{false};
+  const listener* listener_{nullptr};  // while serve() runs
+  // last, so the render thread stops before anything it uses is destroyed
+  std::jthread renderer_{};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+
+#include "rt.h"
+
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// thin wrappers over the widest vector of reals the target supports
+// the width is fixed at compile time by the -march flags and the real type, and the scalar
+// fallback has the same interface with one lane, so kernels are written once against these
+// functions
+namespace raytracer::simd {
+
+#if defined(RAYTRACER_FLOAT) && defined(__AVX512F__)
+
+inline constexpr int kWidth{16};
+using vreal = __m512;
+using vmask = __mmask16;
+
+inline vreal load(const float* p) {
+  return _mm512_loadu_ps(p);
+}
+inline void store(float* p, const vreal v) {
+  _mm512_storeu_ps(p, v);
+}
+inline vreal broadcast(const float v) {
+  return _mm512_set1_ps(v);
+}
+inline vreal lane_index() {
+  return _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+}
+inline vreal add(const vreal a, const vreal b) {
+  return _mm512_add_ps(a, b);
+}
+inline vreal sub(const vreal a, const vreal b) {
+  return _mm512_sub_ps(a, b);
+}
+inline vreal mul(const vreal a, const vreal b) {
+  return _mm512_mul_ps(a, b);
+}
+inline vreal div(const vreal a, const vreal b) {
+  return _mm512_div_ps(a, b);
+}
+inline vreal min(const vreal a, const vreal b) {
+  return _mm512_min_ps(a, b);
+}
+inline vreal max(const vreal a, const vreal b) {
+  return _mm512_max_ps(a, b);
+}
+inline vreal sqrt(const vreal a) {
+  return _mm512_sqrt_ps(a);
+}
+inline vmask less(const vreal a, const vreal b) {
+  return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+}
+inline vmask greater(const vreal a, const vreal b) {
+  return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+}
+inline vmask greater_equal(const vreal a, const vreal b) {
+  return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ);
+}
+inline vmask mask_and(const vmask a, const vmask b) {
+  return static_cast<vmask>(a & b);
+}
+// lanes of a where mask is set, lanes of b elsewhere
+inline vreal select(const vmask mask, const vreal a, const vreal b) {
+  return _mm512_mask_blend_ps(mask, b, a);
+}
+inline unsigned bits(const vmask mask) {
+  return mask;
+}
+
+#elif defined(RAYTRACER_FLOAT) && defined(__AVX__)
+
+inline constexpr int kWidth{8};
+using vreal = __m256;
+using vmask = __m256;
+
+inline vreal load(const float* p) {
+  return _mm256_loadu_ps(p);
+}
+inline void store(float* p, const vreal v) {
+  _mm256_storeu_ps(p, v);
+}
+inline vreal broadcast(const float v) {
+  return _mm256_set1_ps(v);
+}
+inline vreal lane_index() {
+  return _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+}
+inline vreal add(const vreal a, const vreal b) {
+  return _mm256_add_ps(a, b);
+}
+inline vreal sub(const vreal a, const vreal b) {
+  return _mm256_sub_ps(a, b);
+}
+inline vreal mul(const vreal a, const vreal b) {
+  return _mm256_mul_ps(a, b);
+}
+inline vreal div(const vreal a, const vreal b) {
+  return _mm256_div_ps(a, b);
+}
+inline vreal min(const vreal a, const vreal b) {
+  return _mm256_min_ps(a, b);
+}
+inline vreal max(const vreal a, const vreal b) {
+  return _mm256_max_ps(a, b);
+}
+inline vreal sqrt(const vreal a) {
+  return _mm256_sqrt_ps(a);
+}
+inline vmask less(const vreal a, const vreal b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+inline vmask greater(const vreal a, const vreal b) {
+  return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+inline vmask greater_equal(const vreal a, const vreal b) {
+  return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+}
+inline vmask mask_and(const vmask a, const vmask b) {
+  return _mm256_and_ps(a, b);
+}
+// lanes of a where mask is set, lanes of b elsewhere
+inline vreal select(const vmask mask, const vreal a, const vreal b) {
+  return _mm256_blendv_ps(b, a, mask);
+}
+inline unsigned bits(const vmask mask) {
+  return static_cast<unsigned>(_mm256_movemask_ps(mask));
+}
+
+#elif !defined(RAYTRACER_FLOAT) && defined(__AVX512F__)
+
+inline constexpr int kWidth{8};
+using vreal = __m512d;
+using vmask = __mmask8;
+
+inline vreal load(const double* p) {
+  return _mm512_loadu_pd(p);
+}
+inline void store(double* p, const vreal v) {
+  _mm512_storeu_pd(p, v);
+}
+inline vreal broadcast(const double v) {
+  return _mm512_set1_pd(v);
+}
+inline vreal lane_index() {
+  return _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+}
+inline vreal add(const vreal a, const vreal b) {
+  return _mm512_add_pd(a, b);
+}
+inline vreal sub(const vreal a, const vreal b) {
+  return _mm512_sub_pd(a, b);
+}
+inline vreal mul(const vreal a, const vreal b) {
+  return _mm512_mul_pd(a, b);
+}
+inline vreal div(const vreal a, const vreal b) {
+  return _mm512_div_pd(a, b);
+}
+inline vreal min(const vreal a, const vreal b) {
+  return _mm512_min_pd(a, b);
+}
+inline vreal max(const vreal a, const vreal b) {
+  return _mm512_max_pd(a, b);
+}
+inline vreal sqrt(const vreal a) {
+  return _mm512_sqrt_pd(a);
+}
+inline vmask less(const vreal a, const vreal b) {
+  return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+}
+inline vmask greater(const vreal a, const vreal b) {
+  return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+}
+inline vmask greater_equal(const vreal a, const vreal b) {
+  return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ);
+}
+inline vmask mask_and(const vmask a, const vmask b) {
+  return static_cast<vmask>(a & b);
+}
+// lanes of a where mask is set, lanes of b elsewhere
+inline vreal select(const vmask mask, const vreal a, const vreal b) {
+  return _mm512_mask_blend_pd(mask, b, a);
+}
+inline unsigned bits(const vmask mask) {
+  return mask;
+}
+
+#elif !defined(RAYTRACER_FLOAT) && defined(__AVX__)
+
+inline constexpr int kWidth{4};
+using vreal = __m256d;
+using vmask = __m256d;
+
+inline vreal load(const double* p) {
+  return _mm256_loadu_pd(p);
+}
+inline void store(double* p, const vreal v) {
+  _mm256_storeu_pd(p, v);
+}
+inline vreal broadcast(const double v) {
+  return _mm256_set1_pd(v);
+}
+inline vreal lane_index() {
+  return _mm256_set_pd(3, 2, 1, 0);
+}
+inline vreal add(const vreal a, const vreal b) {
+  return _mm256_add_pd(a, b);
+}
+inline vreal sub(const vreal a, const vreal b) {
+  return _mm256_sub_pd(a, b);
+}
+inline vreal mul(const vreal a, const vreal b) {
+  return _mm256_mul_pd(a, b);
+}
+inline vreal div(const vreal a, const vreal b) {
+  return _mm256_div_pd(a, b);
+}
+inline vreal min(const vreal a, const vreal b) {
+  return _mm256_min_pd(a, b);
+}
+inline vreal max(const vreal a, const vreal b) {
+  return _mm256_max_pd(a, b);
+}
+inline vreal sqrt(const vreal a) {
+  return _mm256_sqrt_pd(a);
+}
+inline vmask less(const vreal a, const vreal b) {
+  return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+}
+inline vmask greater(const vreal a, const vreal b) {
+  return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+}
+inline vmask greater_equal(const vreal a, const vreal b) {
+  return _mm256_cmp_pd(a, b, _CMP_GE_OQ);
+}
+inline vmask mask_and(const vmask a, const vmask b) {
+  return _mm256_and_pd(a, b);
+}
+// lanes of a where mask is set, lanes of b elsewhere
+inline vreal select(const vmask mask, const vreal a, const vreal b) {
+  return _mm256_blendv_pd(b, a, mask);
+}
+inline unsigned bits(const vmask mask) {
+  return static_cast<unsigned>(_mm256_movemask_pd(mask));
+}
+
+#else
+
+inline constexpr int kWidth{1};
+using vreal = real;
+using vmask = bool;
+
+inline vreal load(const real* p) {
+  return *p;
+}
+inline void store(real* p, const vreal v) {
+  *p = v;
+}
+inline vreal broadcast(const real v) {
+  return v;
+}
+inline vreal lane_index() {
+  return 0;
+}
+inline vreal add(const vreal a, const vreal b) {
+  return a + b;
+}
+inline vreal sub(const vreal a, const vreal b) {
+  return a - b;
+}
+inline vreal mul(const vreal a, const vreal b) {
+  return a * b;
+}
+inline vreal div(const vreal a, const vreal b) {
+  return a / b;
+}
+inline vreal min(const vreal a, const vreal b) {
+  return a < b ? a : b;
+}
+inline vreal max(const vreal a, const vreal b) {
+  return a > b ? a : b;
+}
+inline vreal sqrt(const vreal a) {
+  return std::sqrt(a);
+}
+inline vmask less(const vreal a, const vreal b) {
+  return a < b;
+}
+inline vmask greater(const vreal a, const vreal b) {
+  return a > b;
+}
+inline vmask greater_equal(const vreal a, const vreal b) {
+  return a >= b;
+}
+inline vmask mask_and(const vmask a, const vmask b) {
+  return a && b;
+}
+// a where mask is set, b otherwise
+inline vreal select(const vmask mask, const vreal a, const vreal b) {
+  return mask ? a : b;
+}
+inline unsigned bits(const vmask mask) {
+  return mask ? 1U : 0U;
+}
+
+#endif
+
+}  // namespace raytracer::simd
+
+#endif
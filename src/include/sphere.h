@@ -1,45 +1,94 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "hash.h"
 #include "hittable.h"
+#include "material.h"
+#include "metrics.h"
 #include "vec3.h"
 
 namespace raytracer {
 
-class sphere : public hittable {
+class sphere final : public hittable {
  public:
-  sphere(const point3& center, const double radius, const std::shared_ptr<material>& material)
-      : center_{center}, radius_{std::fmax(0, radius)}, material_{material} {}
+  sphere(const point3& center, const real radius, const std::shared_ptr<material>& material)
+      : center_{center},
+        radius_{std::max(real{0}, radius)},
+        material_id_{material_table::add(material)} {
+    const auto rvec = vec3{radius_, radius_, radius_};
+    bbox_ = aabb{center_ - rvec, center_ + rvec};
+  }
 
   bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
-    vec3 oc = center_ - r.origin();
+    utility::metrics::count_primitive_tests(1);
+    const vec3 oc = center_ - r.origin();
     const auto a = r.direction().length_squared();
     const auto h = dot(r.direction(), oc);
     const auto c = oc.length_squared() - radius_ * radius_;
-    const auto discriminant = h * h - a * c;
-    if (discriminant < 0.0) {
+    // h * h - a * c loses most of its digits in float once the sphere is small against its
+    // distance, so take the discriminant from the distance between the center and the ray's line
+    const auto perp = oc - (h / a) * r.direction();
+    const auto discriminant = a * (radius_ * radius_ - perp.length_squared());
+    if (discriminant < 0) {
       return false;
     }
-    const auto sqrtd = std::sqrt(discriminant);
-    auto root = (h - sqrtd) / a;
+    // the roots are q / a and c / q, which avoids the cancellation in h - sqrtd that hits rays
+    // leaving the surface, where c is close to zero
+    const auto q = h + std::copysign(std::sqrt(discriminant), h);
+    auto near = c / q;
+    auto far = q / a;
+    if (near > far) {
+      std::swap(near, far);
+    }
+    auto root = near;
     if (!ray_t.surround(root)) {
-      root = (h + sqrtd) / a;
+      root = far;
       if (!ray_t.surround(root)) {
         return false;
       }
     }
     rec.t_ = root;
-    rec.p_ = r.at(rec.t_);
-    vec3 outward_normal = (rec.p_ - center_) / radius_;
-    rec.set_face_normal(r, outward_normal);
-    rec.material_ = material_;
+    rec.prim_id_ = 0;
+    rec.material_id_ = material_id_;
+    rec.object_ = this;
     return true;
   }
 
+  void surface(const ray& r, hit_record& rec) const override {
+    // the normal comes from the computed point, which is then pulled back onto the sphere so
+    // rounding in t does not leave it inside or outside the surface
+    const vec3 outward_normal = unit_vec(r.at(rec.t_) - center_);
+    rec.p_ = center_ + radius_ * outward_normal;
+    rec.set_face_normal(r, outward_normal);
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return bbox_;
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    return hasher{}.add(center_).add(radius_).add(material_table::get(material_id_).hash()).value();
+  }
+
+  [[nodiscard]] const point3& center() const {
+    return center_;
+  }
+  [[nodiscard]] real radius() const {
+    return radius_;
+  }
+  [[nodiscard]] std::uint32_t material_id() const {
+    return material_id_;
+  }
+
  private:
   point3 center_{};
-  double radius_{};
-  std::shared_ptr<material> material_;
+  real radius_{};
+  std::uint32_t material_id_{};
+  aabb bbox_{};
 };
 
 }  // namespace raytracer
@@ -0,0 +1,240 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hash.h"
+#include "hittable.h"
+#include "material.h"
+#include "metrics.h"
+#include "simd.h"
+#include "sphere.h"
+
+namespace raytracer {
+
+// spheres stored as structure of arrays in memory owned elsewhere, intersected simd::kWidth at
+// a time. every array carries kWidth - 1 padding entries at the end, so a batch starting at any
+// sphere can be loaded without bounds checks and the lanes past the range are masked out
+struct sphere_soa {
+  const real* cx_{};                     // NOLINT
+  const real* cy_{};                     // NOLINT
+  const real* cz_{};                     // NOLINT
+  const real* radius_{};                 // NOLINT
+  const std::uint32_t* material_ids_{};  // NOLINT
+  std::uint32_t count_{};                // NOLINT
+  std::uint32_t material_base_{};        // NOLINT added to material_ids_ for material_table
+  const hittable* owner_{};              // NOLINT object reported in hit records
+
+  [[nodiscard]] aabb sphere_bounds(const std::uint32_t idx) const {
+    const auto r = radius_[idx];
+    const auto c = point3{cx_[idx], cy_[idx], cz_[idx]};
+    return aabb{c - vec3{r, r, r}, c + vec3{r, r, r}};
+  }
+
+  // intersect the spheres [first, first + count)
+  bool hit(const ray& r, const interval& ray_t, const std::uint32_t first,
+           const std::uint32_t count, hit_record& rec) const {
+    utility::metrics::count_primitive_tests(count);
+    const auto& ori = r.origin();
+    const auto& dir = r.direction();
+    const auto a = dir.length_squared();
+    const auto ox = simd::broadcast(ori.x());
+    const auto oy = simd::broadcast(ori.y());
+    const auto oz = simd::broadcast(ori.z());
+    const auto dx = simd::broadcast(dir.x());
+    const auto dy = simd::broadcast(dir.y());
+    const auto dz = simd::broadcast(dir.z());
+    const auto va = simd::broadcast(a);
+    const auto inv_a = simd::broadcast(1 / a);
+    const auto t_min = simd::broadcast(ray_t.min());
+    const auto zero = simd::broadcast(0);
+    const auto lanes = simd::lane_index();
+
+    auto closest = ray_t.max();
+    std::uint32_t closest_idx{count_};
+    std::array<real, simd::kWidth> ts{};
+    for (std::uint32_t i = first; i < first + count; i += simd::kWidth) {
+      const auto ocx = simd::sub(simd::load(&cx_[i]), ox);
+      const auto ocy = simd::sub(simd::load(&cy_[i]), oy);
+      const auto ocz = simd::sub(simd::load(&cz_[i]), oz);
+      const auto rad = simd::load(&radius_[i]);
+      // same quadratic as sphere::hit, with h = dot(d, oc) and the discriminant taken from the
+      // distance between the center and the ray's line
+      const auto h =
+          simd::add(simd::add(simd::mul(dx, ocx), simd::mul(dy, ocy)), simd::mul(dz, ocz));
+      const auto oc2 =
+          simd::add(simd::add(simd::mul(ocx, ocx), simd::mul(ocy, ocy)), simd::mul(ocz, ocz));
+      const auto r2 = simd::mul(rad, rad);
+      const auto c = simd::sub(oc2, r2);
+      const auto s = simd::mul(h, inv_a);
+      const auto px = simd::sub(ocx, simd::mul(s, dx));
+      const auto py = simd::sub(ocy, simd::mul(s, dy));
+      const auto pz = simd::sub(ocz, simd::mul(s, dz));
+      const auto perp2 =
+          simd::add(simd::add(simd::mul(px, px), simd::mul(py, py)), simd::mul(pz, pz));
+      const auto discriminant = simd::mul(va, simd::sub(r2, perp2));
+      const auto sqrtd = simd::sqrt(simd::max(discriminant, zero));
+      // roots c / q and q / a with q = h + copysign(sqrtd, h), as in sphere::hit, so neither
+      // cancels for rays leaving a surface in either direction
+      const auto q = simd::select(simd::less(h, zero), simd::sub(h, sqrtd), simd::add(h, sqrtd));
+      const auto root0 = simd::div(c, q);
+      const auto root1 = simd::mul(q, inv_a);
+      const auto near = simd::min(root0, root1);
+      const auto far = simd::max(root0, root1);
+
+      // lanes past the end of the range and rays missing the sphere are masked out
+      const auto valid = simd::mask_and(
+          simd::less(lanes, simd::broadcast(static_cast<real>(first + count - i))),
+          simd::greater_equal(discriminant, zero));
+      const auto t_max = simd::broadcast(closest);
+      const auto near_ok = simd::mask_and(
+          valid, simd::mask_and(simd::greater(near, t_min), simd::less(near, t_max)));
+      const auto far_ok = simd::mask_and(
+          valid, simd::mask_and(simd::greater(far, t_min), simd::less(far, t_max)));
+      auto hits = simd::bits(near_ok) | simd::bits(far_ok);
+      if (hits == 0) {
+        continue;
+      }
+      simd::store(ts.data(), simd::select(near_ok, near, far));
+      while (hits != 0) {
+        const auto lane = std::countr_zero(hits);
+        hits &= hits - 1;
+        if (ts[lane] < closest) {
+          closest = ts[lane];
+          closest_idx = i + lane;
+        }
+      }
+    }
+    if (closest_idx == count_) {
+      return false;
+    }
+
+    rec.t_ = closest;
+    rec.prim_id_ = closest_idx;
+    rec.material_id_ = material_base_ + material_ids_[closest_idx];
+    rec.object_ = owner_;
+    return true;
+  }
+
+  // as sphere::surface
+  void surface(const ray& r, hit_record& rec) const {
+    const auto idx = rec.prim_id_;
+    const auto center = point3{cx_[idx], cy_[idx], cz_[idx]};
+    const vec3 outward_normal = unit_vec(r.at(rec.t_) - center);
+    rec.p_ = center + radius_[idx] * outward_normal;
+    rec.set_face_normal(r, outward_normal);
+  }
+
+  // equal to the hash of a hittable_list holding the same spheres in the same order
+  [[nodiscard]] std::uint64_t hash() const {
+    hasher h{};
+    for (std::uint32_t i = 0; i < count_; i++) {
+      const auto& mat = material_table::get(material_base_ + material_ids_[i]);
+      h.add(hasher{}
+                .add(point3{cx_[i], cy_[i], cz_[i]})
+                .add(radius_[i])
+                .add(mat.hash())
+                .value());
+    }
+    return h.value();
+  }
+};
+
+// owning, growable sphere_soa
+// materials are referenced by their material_table index
+class sphere_set : public hittable {
+ public:
+  sphere_set() {
+    pad();
+  }
+
+  void add(const point3& center, const real radius, const std::shared_ptr<material>& mat) {
+    add(center, radius, material_table::add(mat));
+  }
+
+  void add(const point3& center, const real radius, const std::uint32_t material_id) {
+    const auto r = std::max(real{0}, radius);
+    cx_[count_] = center.x();
+    cy_[count_] = center.y();
+    cz_[count_] = center.z();
+    radius_[count_] = r;
+    material_ids_[count_] = material_id;
+    count_++;
+    pad();
+    const auto rvec = vec3{r, r, r};
+    bbox_ = aabb{bbox_, aabb{center - rvec, center + rvec}};
+  }
+
+  void add(const sphere& obj) {
+    add(obj.center(), obj.radius(), obj.material_id());
+  }
+
+  [[nodiscard]] std::uint32_t size() const {
+    return count_;
+  }
+
+  [[nodiscard]] aabb sphere_bounds(const std::uint32_t idx) const {
+    return view().sphere_bounds(idx);
+  }
+
+  [[nodiscard]] sphere_soa view() const {
+    return sphere_soa{.cx_ = cx_.data(),
+                      .cy_ = cy_.data(),
+                      .cz_ = cz_.data(),
+                      .radius_ = radius_.data(),
+                      .material_ids_ = material_ids_.data(),
+                      .count_ = count_,
+                      .material_base_ = 0,
+                      .owner_ = this};
+  }
+
+  bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
+    return view().hit(r, ray_t, 0, count_, rec);
+  }
+
+  // intersect the spheres [first, first + count)
+  bool hit(const ray& r, const interval& ray_t, const std::uint32_t first,
+           const std::uint32_t count, hit_record& rec) const {
+    return view().hit(r, ray_t, first, count, rec);
+  }
+
+  void surface(const ray& r, hit_record& rec) const override {
+    view().surface(r, rec);
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return bbox_;
+  }
+
+  // equal to the hash of a hittable_list holding the same spheres in the same order
+  [[nodiscard]] std::uint64_t hash() const override {
+    return view().hash();
+  }
+
+ private:
+  void pad() {
+    const auto padded = count_ + simd::kWidth;
+    cx_.resize(padded);
+    cy_.resize(padded);
+    cz_.resize(padded);
+    radius_.resize(padded);
+    material_ids_.resize(padded);
+  }
+
+  std::uint32_t count_{0};
+  std::vector<real> cx_{};
+  std::vector<real> cy_{};
+  std::vector<real> cz_{};
+  std::vector<real> radius_{};
+  std::vector<std::uint32_t> material_ids_{};
+  aabb bbox_{};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "aabb.h"
+#include "hash.h"
+#include "ray.h"
+#include "rt.h"
+#include "vec3.h"
+
+namespace raytracer {
+
+// affine transform, stored as the top three rows of a row-major 4x4 matrix
+class transform {
+ public:
+  constexpr transform() = default;
+
+  static constexpr transform translate(const vec3& offset) {
+    return transform{{1, 0, 0, offset.x(), 0, 1, 0, offset.y(), 0, 0, 1, offset.z()}};
+  }
+
+  static constexpr transform scale(const vec3& factor) {
+    return transform{{factor.x(), 0, 0, 0, 0, factor.y(), 0, 0, 0, 0, factor.z(), 0}};
+  }
+
+  static constexpr transform scale(const real factor) {
+    return scale(vec3{factor, factor, factor});
+  }
+
+  // counterclockwise rotation about axis, looking down the axis towards the origin
+  static transform rotate(const vec3& axis, const double degrees) {
+    const auto a = unit_vec(axis);
+    const auto theta = degrees2radians(degrees);
+    const auto c = static_cast<real>(std::cos(theta));
+    const auto s = static_cast<real>(std::sin(theta));
+    const auto t = 1 - c;
+    const auto x = a.x();
+    const auto y = a.y();
+    const auto z = a.z();
+    return transform{{t * x * x + c, t * x * y - s * z, t * x * z + s * y, 0,  //
+                      t * x * y + s * z, t * y * y + c, t * y * z - s * x, 0,  //
+                      t * x * z - s * y, t * y * z + s * x, t * z * z + c, 0}};
+  }
+
+  // lhs applied after rhs
+  friend constexpr transform operator*(const transform& lhs, const transform& rhs) {
+    transform out{};
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 4; col++) {
+        real sum = col == 3 ? lhs.at(row, 3) : 0;
+        for (int k = 0; k < 3; k++) {
+          sum += lhs.at(row, k) * rhs.at(k, col);
+        }
+        out.m_[(4 * row) + col] = sum;
+      }
+    }
+    return out;
+  }
+
+  [[nodiscard]] constexpr point3 point(const point3& p) const {
+    return vector(p) + vec3{m_[3], m_[7], m_[11]};
+  }
+
+  [[nodiscard]] constexpr vec3 vector(const vec3& v) const {
+    return vec3{(m_[0] * v.x()) + (m_[1] * v.y()) + (m_[2] * v.z()),
+                (m_[4] * v.x()) + (m_[5] * v.y()) + (m_[6] * v.z()),
+                (m_[8] * v.x()) + (m_[9] * v.y()) + (m_[10] * v.z())};
+  }
+
+  // v times the transposed linear part. on the inverse of a transform this maps normals the
+  // transform would otherwise skew
+  [[nodiscard]] constexpr vec3 transposed_vector(const vec3& v) const {
+    return vec3{(m_[0] * v.x()) + (m_[4] * v.y()) + (m_[8] * v.z()),
+                (m_[1] * v.x()) + (m_[5] * v.y()) + (m_[9] * v.z()),
+                (m_[2] * v.x()) + (m_[6] * v.y()) + (m_[10] * v.z())};
+  }
+
+  // the direction is not normalized, so distances along the ray are the same on both sides
+  [[nodiscard]] ray apply(const ray& r) const {
+    return ray{point(r.origin()), vector(r.direction())};
+  }
+
+  // box enclosing the transformed box (arvo 1990)
+  [[nodiscard]] constexpr aabb bounds(const aabb& box) const {
+    if (box.empty()) {
+      return box;
+    }
+    std::array<interval, 3> out{};
+    for (int row = 0; row < 3; row++) {
+      auto lo = m_[(4 * row) + 3];
+      auto hi = lo;
+      for (int col = 0; col < 3; col++) {
+        const auto& ax = box.axis_interval(col);
+        const auto a = at(row, col) * ax.min();
+        const auto b = at(row, col) * ax.max();
+        lo += a < b ? a : b;
+        hi += a < b ? b : a;
+      }
+      out[row] = interval{lo, hi};
+    }
+    return aabb{out[0], out[1], out[2]};
+  }
+
+  // inverse of the transform, which must not be singular
+  [[nodiscard]] constexpr transform inverse() const {
+    const auto cof = [&](const int r0, const int r1, const int c0, const int c1) {
+      return (at(r0, c0) * at(r1, c1)) - (at(r0, c1) * at(r1, c0));
+    };
+    // inverse of the linear part from its cofactors, then the inverse translation
+    const std::array<real, 9> adj{cof(1, 2, 1, 2), -cof(0, 2, 1, 2), cof(0, 1, 1, 2),
+                                  -cof(1, 2, 0, 2), cof(0, 2, 0, 2), -cof(0, 1, 0, 2),
+                                  cof(1, 2, 0, 1), -cof(0, 2, 0, 1), cof(0, 1, 0, 1)};
+    const auto det = (at(0, 0) * adj[0]) + (at(0, 1) * adj[3]) + (at(0, 2) * adj[6]);
+    const auto inv_det = 1 / det;
+    transform out{};
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 3; col++) {
+        out.m_[(4 * row) + col] = adj[(3 * row) + col] * inv_det;
+      }
+    }
+    const auto t = out.vector(vec3{m_[3], m_[7], m_[11]});
+    out.m_[3] = -t.x();
+    out.m_[7] = -t.y();
+    out.m_[11] = -t.z();
+    return out;
+  }
+
+  [[nodiscard]] std::uint64_t hash() const {
+    hasher h{};
+    for (const auto v : m_) {
+      h.add(static_cast<double>(v));
+    }
+    return h.value();
+  }
+
+ private:
+  explicit constexpr transform(const std::array<real, 12>& m) : m_{m} {}
+
+  [[nodiscard]] constexpr real at(const int row, const int col) const {
+    return m_[(4 * row) + col];
+  }
+
+  std::array<real, 12> m_{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+};
+
+}  // namespace raytracer
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "aabb.h"
+#include "bvh.h"
+#include "bvh_tree.h"
+#include "hash.h"
+#include "hittable.h"
+#include "lbvh.h"
+#include "material.h"
+#include "metrics.h"
+#include "timer.h"
+
+namespace raytracer {
+
+// indexed triangles sharing one vertex buffer and one material, with a bvh of their own
+// triangles are kept in leaf order as three vertex indices each, so the bvh needs no
+// separate primitive list. the whole mesh is one object of the enclosing aggregate
+class triangle_mesh final : public hittable {
+ public:
+  // `indices` holds three indices into `vertices` per triangle
+  triangle_mesh(std::vector<point3> vertices, const std::vector<std::uint32_t>& indices,
+                const std::shared_ptr<material>& mat, const bvh_options& opts = {})
+      : vertices_{std::move(vertices)}, material_id_{material_table::add(mat)} {
+    utility::timer timer{};
+    const utility::phase_timer phase{"mesh build"};
+    const auto count = indices.size() / 3;
+    std::vector<aabb> bounds(count);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::size_t i = 0; i < count; i++) {
+      const auto& v0 = vertices_[indices[3 * i]];
+      const auto& v1 = vertices_[indices[(3 * i) + 1]];
+      const auto& v2 = vertices_[indices[(3 * i) + 2]];
+      bounds[i] = aabb{aabb{v0, v1}, aabb{v2, v2}};
+    }
+
+    std::vector<std::uint32_t> order{};
+    if (opts.method_ == bvh_build_method::kMorton) {
+      const lbvh_builder::settings settings{.morton_bits_ = opts.morton_bits_,
+                                            .treelet_passes_ = opts.treelet_passes_,
+                                            .max_leaf_size_ = opts.max_leaf_size_};
+      tree_ = lbvh_builder::build(bounds, settings, order);
+    } else {
+      tree_ = bvh_tree::build_sah(bounds, opts.max_leaf_size_, order);
+    }
+    triangles_.resize(count);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::size_t slot = 0; slot < count; slot++) {
+      const auto idx = order[slot];
+      triangles_[slot] = {indices[3 * idx], indices[(3 * idx) + 1], indices[(3 * idx) + 2]};
+    }
+    timer.report(std::format("[mesh]: {} triangles, {} vertices, {} bvh nodes.", count,
+                             vertices_.size(), tree_.nodes().size()));
+  }
+
+  bool hit(const ray& r, const interval& ray_t, hit_record& rec) const override {
+    const watertight_ray wr{r};
+    return tree_.hit(r, ray_t,
+                     [&](const std::uint32_t first, const std::uint32_t count, real& closest) {
+                       utility::metrics::count_primitive_tests(count);
+                       bool hit_anything{false};
+                       for (auto i = first; i < first + count; i++) {
+                         if (wr.hit(triangle(i), interval{ray_t.min(), closest}, closest)) {
+                           hit_anything = true;
+                           rec.t_ = closest;
+                           rec.prim_id_ = i;
+                         }
+                       }
+                       if (hit_anything) {
+                         rec.material_id_ = material_id_;
+                         rec.object_ = this;
+                       }
+                       return hit_anything;
+                     });
+  }
+
+  // flat shading with the geometric normal, counterclockwise triangles face outward
+  void surface(const ray& r, hit_record& rec) const override {
+    const auto [v0, v1, v2] = triangle(rec.prim_id_);
+    rec.p_ = r.at(rec.t_);
+    rec.set_face_normal(r, unit_vec(cross(v1 - v0, v2 - v0)));
+  }
+
+  [[nodiscard]] aabb bounding_box() const override {
+    return tree_.bounding_box();
+  }
+
+  [[nodiscard]] std::uint64_t hash() const override {
+    hasher h{};
+    for (std::uint32_t i = 0; i < triangles_.size(); i++) {
+      const auto [v0, v1, v2] = triangle(i);
+      h.add(v0).add(v1).add(v2);
+    }
+    return h.add(material_table::get(material_id_).hash()).value();
+  }
+
+  [[nodiscard]] std::size_t triangle_count() const {
+    return triangles_.size();
+  }
+
+  [[nodiscard]] std::size_t vertex_count() const {
+    return vertices_.size();
+  }
+
+ private:
+  using corners = std::array<point3, 3>;
+
+  [[nodiscard]] corners triangle(const std::uint32_t i) const {
+    const auto& tri = triangles_[i];
+    return {vertices_[tri[0]], vertices_[tri[1]], vertices_[tri[2]]};
+  }
+
+  // ray set up for watertight ray/triangle tests (woop, benthin and wald 2013)
+  // vertices are moved into a space where the ray starts at the origin and runs along +z, so
+  // the edge tests of two triangles sharing an edge are exactly complementary and rays cannot
+  // slip through the crack between them
+  class watertight_ray {
+   public:
+    explicit watertight_ray(const ray& r) : origin_{r.origin()} {
+      const auto& d = r.direction();
+      const auto ax = std::abs(d.x());
+      const auto ay = std::abs(d.y());
+      const auto az = std::abs(d.z());
+      kz_ = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+      kx_ = (kz_ + 1) % 3;
+      ky_ = (kx_ + 1) % 3;
+      if (axis(d, kz_) < 0) {
+        std::swap(kx_, ky_);
+      }
+      sz_ = 1 / axis(d, kz_);
+      sx_ = axis(d, kx_) * sz_;
+      sy_ = axis(d, ky_) * sz_;
+    }
+
+    // shrink t to the hit distance when the triangle is hit inside ray_t
+    bool hit(const corners& tri, const interval& ray_t, real& t) const {
+      const auto a = tri[0] - origin_;
+      const auto b = tri[1] - origin_;
+      const auto c = tri[2] - origin_;
+      const auto ax = axis(a, kx_) - (sx_ * axis(a, kz_));
+      const auto ay = axis(a, ky_) - (sy_ * axis(a, kz_));
+      const auto bx = axis(b, kx_) - (sx_ * axis(b, kz_));
+      const auto by = axis(b, ky_) - (sy_ * axis(b, kz_));
+      const auto cx = axis(c, kx_) - (sx_ * axis(c, kz_));
+      const auto cy = axis(c, ky_) - (sy_ * axis(c, kz_));
+      // scaled barycentric coordinates, from edge functions that are exact in sign in double.
+      // float needs the double fallback when one of them rounds to zero
+      auto u = (cx * by) - (cy * bx);
+      auto v = (ax * cy) - (ay * cx);
+      auto w = (bx * ay) - (by * ax);
+      if constexpr (sizeof(real) == sizeof(float)) {
+        if (u == 0 || v == 0 || w == 0) {
+          u = static_cast<real>((double{cx} * by) - (double{cy} * bx));
+          v = static_cast<real>((double{ax} * cy) - (double{ay} * cx));
+          w = static_cast<real>((double{bx} * ay) - (double{by} * ax));
+        }
+      }
+      if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) {
+        return false;
+      }
+      const auto det = u + v + w;
+      if (det == 0) {
+        return false;
+      }
+      // t * det, compared against the interval scaled by det to leave the division for hits
+      const auto tz = sz_ * ((u * axis(a, kz_)) + (v * axis(b, kz_)) + (w * axis(c, kz_)));
+      const auto scaled = det < 0 ? -tz : tz;
+      const auto abs_det = std::abs(det);
+      if (scaled <= ray_t.min() * abs_det || scaled >= ray_t.max() * abs_det) {
+        return false;
+      }
+      t = scaled / abs_det;
+      return true;
+    }
+
+   private:
+    [[nodiscard]] static real axis(const vec3& v, const int n) {
+      return n == 0 ? v.x() : (n == 1 ? v.y() : v.z());
+    }
+
+    point3 origin_;
+    int kx_{};
+    int ky_{};
+    int kz_{};
+    real sx_{};
+    real sy_{};
+    real sz_{};
+  };
+
+  std::vector<point3> vertices_;
+  std::vector<std::array<std::uint32_t, 3>> triangles_{};
+  std::uint32_t material_id_;
+  bvh_tree tree_{};
+};
+
+}  // namespace raytracer
+
+#endif
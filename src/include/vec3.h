@@ -1,6 +1,7 @@
 #ifndef VEC3_H
 #define VEC3_H
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <format>
@@ -11,29 +12,29 @@ namespace raytracer {
 
 class vec3 {
  private:
-  double x_;
-  double y_;
-  double z_;
+  real x_;
+  real y_;
+  real z_;
 
  public:
   constexpr vec3() = default;
-  constexpr vec3(const double x, const double y, const double z) : x_{x}, y_{y}, z_{z} {}
+  constexpr vec3(const real x, const real y, const real z) : x_{x}, y_{y}, z_{z} {}
 
-  [[nodiscard]] constexpr double x() const {
+  [[nodiscard]] constexpr real x() const {
     return x_;
   }
-  [[nodiscard]] constexpr double y() const {
+  [[nodiscard]] constexpr real y() const {
     return y_;
   }
-  [[nodiscard]] constexpr double z() const {
+  [[nodiscard]] constexpr real z() const {
     return z_;
   }
 
-  [[nodiscard]] constexpr double length_squared() const {
+  [[nodiscard]] constexpr real length_squared() const {
     return (x_ * x_) + (y_ * y_) + (z_ * z_);
   }
 
-  [[nodiscard]] constexpr double length() const {
+  [[nodiscard]] constexpr real length() const {
     return std::sqrt(length_squared());
   }
 
@@ -43,11 +44,14 @@ class vec3 {
   }
 
   static vec3 random() {
-    return vec3{random_double(), random_double(), random_double()};
+    return vec3{static_cast<real>(random_double()), static_cast<real>(random_double()),
+                static_cast<real>(random_double())};
   }
 
-  static vec3 random(const double min, const double max) {
-    return vec3{random_double(min, max), random_double(min, max), random_double(min, max)};
+  static vec3 random(const real min, const real max) {
+    return vec3{static_cast<real>(random_double(min, max)),
+                static_cast<real>(random_double(min, max)),
+                static_cast<real>(random_double(min, max))};
   }
 
   constexpr vec3 operator-() const {
@@ -57,10 +61,10 @@ class vec3 {
   constexpr vec3& operator+=(const vec3& rhs) {
     return (x_ += rhs.x(), y_ += rhs.y(), z_ += rhs.z(), *this);
   }
-  constexpr vec3& operator*=(const double rhs) {
+  constexpr vec3& operator*=(const real rhs) {
     return (x_ *= rhs, y_ *= rhs, z_ *= rhs, *this);
   }
-  constexpr vec3& operator/=(const double rhs) {
+  constexpr vec3& operator/=(const real rhs) {
     return *this *= (1 / rhs);
   }
 };
@@ -77,19 +81,19 @@ constexpr vec3 operator*(const vec3& lhs, const vec3& rhs) {
   return vec3{lhs.x() * rhs.x(), lhs.y() * rhs.y(), lhs.z() * rhs.z()};
 }
 
-constexpr vec3 operator*(const double lhs, const vec3& rhs) {
+constexpr vec3 operator*(const real lhs, const vec3& rhs) {
   return vec3{lhs * rhs.x(), lhs * rhs.y(), lhs * rhs.z()};
 }
 
-constexpr vec3 operator*(const vec3& lhs, const double rhs) {
+constexpr vec3 operator*(const vec3& lhs, const real rhs) {
   return rhs * lhs;
 }
 
-constexpr vec3 operator/(const vec3& lhs, const double rhs) {
+constexpr vec3 operator/(const vec3& lhs, const real rhs) {
   return 1 / rhs * lhs;
 }
 
-constexpr double dot(const vec3& lhs, const vec3& rhs) {
+constexpr real dot(const vec3& lhs, const vec3& rhs) {
   return (lhs.x() * rhs.x()) + (lhs.y() * rhs.y()) + (lhs.z() * rhs.z());
 }
 
@@ -102,23 +106,39 @@ constexpr vec3 unit_vec(const vec3& vec) {
   return vec / vec.length();
 }
 
+// point of the unit disk for a point (u, v) of the unit square
+// shirley and chiu's concentric map: no rejection, and nearby square points stay nearby, so
+// stratified square samples stay stratified on the disk
+inline vec3 square_to_disk(const real u, const real v) {
+  const auto a = (2 * u) - 1;
+  const auto b = (2 * v) - 1;
+  if (a == 0 && b == 0) {
+    return vec3{0, 0, 0};
+  }
+  if (std::abs(a) > std::abs(b)) {
+    const auto phi = (pi / 4) * (b / a);
+    return vec3{a * std::cos(phi), a * std::sin(phi), 0};
+  }
+  const auto phi = (pi / 2) - ((pi / 4) * (a / b));
+  return vec3{b * std::cos(phi), b * std::sin(phi), 0};
+}
+
+// point of the unit sphere for a point (u, v) of the unit square, uniform in area
+inline vec3 square_to_sphere(const real u, const real v) {
+  const auto z = 1 - (2 * u);
+  const auto r = std::sqrt(std::max(real{0}, 1 - (z * z)));
+  const auto phi = 2 * pi * v;
+  return vec3{r * std::cos(phi), r * std::sin(phi), z};
+}
+
 inline vec3 random_in_unit_disk() {
-  while (true) {
-    auto p = vec3{random_double(-1, 1), random_double(-1, 1), 0};
-    if (p.length_squared() < 1) {
-      return p;
-    }
-  }
+  const auto u = random_double();
+  return square_to_disk(u, random_double());
 }
 
 inline vec3 random_unit_vector() {
-  while (true) {
-    auto p = vec3::random(-1, 1);
-    auto lensq = p.length_squared();
-    if (lensq > 1e-160 && lensq <= 1) {
-      return p / std::sqrt(lensq);
-    }
-  }
+  const auto u = random_double();
+  return square_to_sphere(u, random_double());
 }
 
 inline vec3 random_on_hemisphere(const vec3& normal) {
@@ -134,8 +154,8 @@ inline vec3 reflect(const vec3& incident, const vec3& normal) {
   return incident - 2 * dot(incident, normal) * normal;
 }
 
-inline vec3 refract(const vec3& incident, const vec3& normal, double etai_over_etat) {
-  const double cos_theta = std::fmin(dot(-incident, normal), 1.0);
+inline vec3 refract(const vec3& incident, const vec3& normal, real etai_over_etat) {
+  const real cos_theta = std::fmin(dot(-incident, normal), 1.0);
   const vec3 out_perpendicular = etai_over_etat * (incident + cos_theta * normal);
   const vec3 out_parallel =
       -std::sqrt(std::fabs(1.0 - out_perpendicular.length_squared())) * normal;
@@ -0,0 +1,328 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stop_token>
+#include <vector>
+
+#include "color.h"
+#include "hittable.h"
+#include "material.h"
+#include "rng.h"
+#include "roulette.h"
+#include "sampler.h"
+
+namespace raytracer {
+
+// queue based path tracer
+// instead of following one path to the end, a wave of paths advances one bounce at a time
+// through separate stages (generate, intersect, scatter, accumulate), each a flat parallel loop
+// over structure-of-arrays path state. hits are grouped by material kind before scattering,
+// so each scatter loop runs a single material's code
+class wavefront_integrator {
+ public:
+  // every stage runs on `threads` openmp threads, whatever the openmp default is
+  wavefront_integrator(const int width, const int samples_per_pixel, const int max_depth,
+                       const int roulette_depth, const std::size_t wave_size,
+                       const sampler& path_sampler, const int threads) {
+    configure(width, samples_per_pixel, max_depth, roulette_depth, wave_size, path_sampler,
+              threads);
+  }
+
+  // settings for later renders, as the constructor takes them
+  // the path buffers are kept, and only grow when a wave holds more paths than any before
+  void configure(const int width, const int samples_per_pixel, const int max_depth,
+                 const int roulette_depth, const std::size_t wave_size,
+                 const sampler& path_sampler, const int threads) {
+    width_ = width;
+    spp_ = std::max(1, samples_per_pixel);  // the wave is sized in whole pixels, see below
+    max_depth_ = max_depth;
+    roulette_depth_ = roulette_depth;
+    sampler_ = path_sampler;
+    // every pixel's samples travel in the same wave, so the wave holds whole pixels
+    wave_pixels_ = std::max<std::size_t>(1, wave_size / spp_);
+    threads_ = std::max(1, threads);
+    resize(wave_pixels_ * spp_);
+  }
+
+  // render the pixels [first_pixel, first_pixel + pixels.size()) of the image, in row-major order
+  // `get_ray(i, j)` returns a new camera ray through pixel (i, j)
+  // once stop is requested the render returns after the bounce in progress, leaving the pixels
+  // incomplete
+  template <typename RayGen>
+  void render(const hittable& world, RayGen&& get_ray, const std::size_t first_pixel,
+              std::span<color> pixels, const std::stop_token& stop = {}) {
+    stats_ = {};
+    for (std::size_t first = 0; first < pixels.size(); first += wave_pixels_) {
+      if (stop.stop_requested()) {
+        return;
+      }
+      const auto count = std::min(wave_pixels_, pixels.size() - first);
+      generate(first_pixel + first, count, get_ray);
+      const auto paths = queue_.size();
+      for (int depth = 0; depth < max_depth_ && !queue_.empty(); depth++) {
+        if (stop.stop_requested()) {
+          return;
+        }
+        utility::metrics::count_rays(depth, queue_.size());
+        intersect(world);
+        group(queue_, sorted_);
+        if (depth + 1 >= roulette_depth_) {
+          draw_roulette(first_pixel + first, paths, depth);
+        }
+        scatter(depth);
+        compact();
+      }
+      accumulate(pixels.subspan(first, count));
+    }
+  }
+
+  // paths traced by the last render() call
+  [[nodiscard]] const path_stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  static constexpr int kBlocks{64};
+  static constexpr std::size_t kRouletteChunk{4096};  // roulette values one thread draws at once
+  // group keys: one per material kind, then rays that left the scene
+  static constexpr std::uint8_t kMissKey{kMaterialKinds};
+  static constexpr int kKeys{kMaterialKinds + 1};
+  // keys after scattering
+  static constexpr std::uint8_t kAlive{0};
+  static constexpr std::uint8_t kAbsorbed{1};
+
+  void resize(const std::size_t paths) {
+    for (auto* v : {&ox_, &oy_, &oz_, &dx_, &dy_, &dz_, &tr_, &tg_, &tb_, &lr_, &lg_, &lb_}) {
+      v->resize(paths);
+    }
+    samplers_.resize(paths);
+    roulette_.resize(paths);
+    hits_.resize(paths);
+    keys_.resize(paths);
+    queue_.reserve(paths);
+    sorted_.resize(paths);
+  }
+
+  [[nodiscard]] ray path_ray(const std::uint32_t k) const {
+    return ray{point3{ox_[k], oy_[k], oz_[k]}, vec3{dx_[k], dy_[k], dz_[k]}};
+  }
+
+  void set_path_ray(const std::uint32_t k, const ray& r) {
+    const auto& o = r.origin();
+    const auto& d = r.direction();
+    ox_[k] = o.x();
+    oy_[k] = o.y();
+    oz_[k] = o.z();
+    dx_[k] = d.x();
+    dy_[k] = d.y();
+    dz_[k] = d.z();
+  }
+
+  // stage 1: one camera ray per sample of every pixel in the wave
+  // the samples of pixel p are the paths [p * spp, (p + 1) * spp) of the wave. each path keeps
+  // its own sampler, started like camera::begin_sample, and loads it into the thread for every
+  // stage that draws sample values
+  template <typename RayGen>
+  void generate(const std::size_t first_pixel, const std::size_t pixel_count, RayGen&& get_ray) {
+    const auto paths = static_cast<std::uint32_t>(pixel_count * spp_);
+    queue_.resize(paths);
+    stats_.paths_ += paths;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads_)
+#endif
+    for (std::uint32_t k = 0; k < paths; k++) {
+      const auto pixel = first_pixel + (k / spp_);
+      const auto i = static_cast<int>(pixel % width_);
+      const auto j = static_cast<int>(pixel / width_);
+      auto& s = thread_sampler();
+      s = sampler_;
+      s.start(pixel, k % static_cast<std::uint32_t>(spp_));
+      set_path_ray(k, get_ray(i, j));
+      samplers_[k] = s;
+      tr_[k] = tg_[k] = tb_[k] = 1;
+      lr_[k] = lg_[k] = lb_[k] = 0;
+      queue_[k] = k;
+    }
+  }
+
+  // stage 2: closest hit of every live path, keyed by the material it hit
+  // paths leaving the scene pick up the sky radiance here and end
+  void intersect(const hittable& world) {
+    const auto size = static_cast<std::int64_t>(queue_.size());
+    stats_.segments_ += queue_.size();
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 256) num_threads(threads_)
+#endif
+    for (std::int64_t q = 0; q < size; q++) {
+      const auto k = queue_[q];
+      const auto r = path_ray(k);
+      // the intersection point may result in round to zero if t is too small
+      // we should ignore such root
+      if (world.closest_hit(r, interval{kRayEpsilon, +infinite}, hits_[k])) {
+        keys_[k] = static_cast<std::uint8_t>(material_table::kind(hits_[k].material_id_));
+      } else {
+        const auto background = sky(r.direction());
+        lr_[k] += tr_[k] * background.x();
+        lg_[k] += tg_[k] * background.y();
+        lb_[k] += tb_[k] * background.z();
+        keys_[k] = kMissKey;
+      }
+    }
+  }
+
+  // stable counting sort of the paths `in` by key into `out`, in parallel over fixed blocks
+  // bucket b of the result is out[offsets_[b], offsets_[b + 1])
+  void group(const std::span<const std::uint32_t> in, std::vector<std::uint32_t>& out) {
+    const auto size = in.size();
+    out.resize(size);
+    const auto block_size = (size + kBlocks - 1) / kBlocks;
+    std::array<std::array<std::uint32_t, kKeys>, kBlocks> counts{};
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads_)
+#endif
+    for (int b = 0; b < kBlocks; b++) {
+      const auto end = std::min(size, (b + 1) * block_size);
+      for (auto q = b * block_size; q < end; q++) {
+        counts[b][keys_[in[q]]]++;
+      }
+    }
+    std::uint32_t running{0};
+    for (int key = 0; key < kKeys; key++) {
+      offsets_[key] = running;
+      for (int b = 0; b < kBlocks; b++) {
+        const auto count = counts[b][key];
+        counts[b][key] = running;
+        running += count;
+      }
+    }
+    offsets_[kKeys] = running;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads_)
+#endif
+    for (int b = 0; b < kBlocks; b++) {
+      const auto end = std::min(size, (b + 1) * block_size);
+      for (auto q = b * block_size; q < end; q++) {
+        const auto k = in[q];
+        out[counts[b][keys_[k]]++] = k;
+      }
+    }
+  }
+
+  // one uniform value per path of the wave for this depth's russian roulette, drawn in bulk
+  // rather than from each path's sampler. the wave's paths are cut into chunks, each filled from
+  // the same stream advanced to the chunk's first path, so the values are those of one sequential
+  // fill whatever the thread count. the stream ids are small depths, which the mixed ids of
+  // pcg32::for_sample practically never hit
+  void draw_roulette(const std::size_t first_pixel, const std::size_t paths, const int depth) {
+    const pcg32 stream{mix64(sampler_.seed() ^ mix64(first_pixel)),
+                       static_cast<std::uint64_t>(depth)};
+    const auto chunks = static_cast<std::int64_t>((paths + kRouletteChunk - 1) / kRouletteChunk);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads_)
+#endif
+    for (std::int64_t c = 0; c < chunks; c++) {
+      const auto first = static_cast<std::size_t>(c) * kRouletteChunk;
+      auto rng = stream;
+      rng.advance(first);
+      rng.fill(
+          std::span<double>{roulette_}.subspan(first, std::min(kRouletteChunk, paths - first)));
+    }
+  }
+
+  // stage 3: scatter the paths of each material kind in its own loop
+  // from roulette_depth_ segments on, russian roulette ends some paths here as in
+  // camera::ray_color, with the values of draw_roulette()
+  void scatter(const int depth) {
+    const auto roulette = depth + 1 >= roulette_depth_;
+    for (int key = 0; key < kMaterialKinds; key++) {
+      const std::span<std::uint32_t> bucket{sorted_.data() + offsets_[key],
+                                            sorted_.data() + offsets_[key + 1]};
+      const auto size = static_cast<std::int64_t>(bucket.size());
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 256) num_threads(threads_)
+#endif
+      for (std::int64_t q = 0; q < size; q++) {
+        const auto k = bucket[q];
+        const auto& rec = hits_[k];
+        thread_sampler() = samplers_[k];
+        ray scattered{};
+        color attenuation{};
+        if (material_table::scatter(rec.material_id_, path_ray(k), rec, attenuation, scattered)) {
+          set_path_ray(k, scattered);
+          tr_[k] *= attenuation.x();
+          tg_[k] *= attenuation.y();
+          tb_[k] *= attenuation.z();
+          keys_[k] = kAlive;
+          if (roulette) {
+            const auto survival = survival_probability(color{tr_[k], tg_[k], tb_[k]});
+            if (roulette_[k] >= survival) {
+              keys_[k] = kAbsorbed;
+            } else {
+              tr_[k] /= survival;
+              tg_[k] /= survival;
+              tb_[k] /= survival;
+            }
+          }
+          samplers_[k] = thread_sampler();
+        } else {
+          keys_[k] = kAbsorbed;
+        }
+      }
+    }
+  }
+
+  // the paths that scattered make up the next bounce's queue, and absorbed paths end with
+  // whatever radiance they gathered so far
+  void compact() {
+    const auto hits = offsets_[kMaterialKinds];
+    group(std::span<const std::uint32_t>{sorted_.data(), hits}, queue_);
+    queue_.resize(offsets_[kAlive + 1]);
+  }
+
+  // stage 4: average the samples of each pixel of the wave
+  void accumulate(std::span<color> pixels) const {
+    const auto scale = 1.0 / spp_;
+    const auto count = static_cast<std::int64_t>(pixels.size());
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads_)
+#endif
+    for (std::int64_t p = 0; p < count; p++) {
+      color sum{0, 0, 0};
+      for (auto k = p * spp_; k < (p + 1) * spp_; k++) {
+        sum += color{lr_[k], lg_[k], lb_[k]};
+      }
+      pixels[p] = scale * sum;
+    }
+  }
+
+  int width_{};
+  int spp_{};
+  int max_depth_{};
+  int roulette_depth_{};
+  sampler sampler_{};
+  std::size_t wave_pixels_{};
+  int threads_{};  // threads of every stage loop, the camera's thread count
+  path_stats stats_{};
+
+  // path state, indexed by path id
+  std::vector<real> ox_{}, oy_{}, oz_{};  // ray origin
+  std::vector<real> dx_{}, dy_{}, dz_{};  // ray direction
+  std::vector<real> tr_{}, tg_{}, tb_{};  // throughput
+  std::vector<real> lr_{}, lg_{}, lb_{};  // radiance gathered so far
+  std::vector<sampler> samplers_{};       // sample values
+  std::vector<double> roulette_{};        // roulette values of the current depth
+  std::vector<hit_record> hits_{};
+  std::vector<std::uint8_t> keys_{};
+
+  std::vector<std::uint32_t> queue_{};   // live path ids
+  std::vector<std::uint32_t> sorted_{};  // live path ids grouped by key
+  std::array<std::uint32_t, kKeys + 1> offsets_{};
+};
+
+}  // namespace raytracer
+
+#endif
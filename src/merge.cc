@@ -0,0 +1,100 @@
+#include <cstdint>
+#include <format>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "include/film.h"
+#include "include/image.h"
+
+namespace rt = raytracer;
+
+// usage: raytracer_merge <image> <partial>... [--film <path>]
+// adds up the partial films of one frame, as written by raytracer --partial_path, and writes the
+// mean radiance of every pixel to <image>, a pfm when its extension is .pfm and a binary ppm
+// otherwise. --film also saves the merged film, which merges again like a partial and resumes
+// like a checkpoint. partials record their tile and sample ranges, and the merge fails rather
+// than count a range twice or add films of different sizes. a frame split over four local
+// processes by sample range:
+//   for k in 0 1 2 3; do
+//     raytracer scene.txt --partial_path part$k.film --sample_begin $((k * 64))
+//                         --sample_end $((k * 64 + 64)) --threads 2 &
+//   done; wait
+//   raytracer_merge frame.ppm part0.film part1.film part2.film part3.film
+int main(int argc, char* argv[]) {
+  std::string image_path{};
+  std::string film_path{};
+  std::vector<std::string> partials{};
+  for (int a = 1; a < argc; a++) {
+    const std::string_view arg{argv[a]};
+    if (arg == "--film" && a + 1 < argc) {
+      film_path = argv[++a];
+    } else if (image_path.empty()) {
+      image_path = arg;
+    } else {
+      partials.emplace_back(arg);
+    }
+  }
+  if (image_path.empty() || partials.empty()) {
+    std::println(stderr, "usage: raytracer_merge <image> <partial>... [--film <path>]");
+    return 1;
+  }
+
+  rt::film merged{};
+  std::uint64_t scene_hash{};
+  for (std::size_t k = 0; k < partials.size(); k++) {
+    auto stored = rt::film::read(partials[k]);
+    if (!stored) {
+      std::println(stderr, "{}: not a film", partials[k]);
+      return 1;
+    }
+    auto& [part, hash] = *stored;
+    if (k == 0) {
+      merged = std::move(part);
+      scene_hash = hash;
+      continue;
+    }
+    // partials of another frame or camera would add up to nonsense
+    if (hash != scene_hash || part.width() != merged.width() ||
+        part.height() != merged.height()) {
+      std::println(stderr, "{}: belongs to a different frame than {}", partials[k], partials[0]);
+      return 1;
+    }
+    try {
+      merged += part;
+    } catch (const std::runtime_error& e) {
+      std::println(stderr, "{}: {}", partials[k], e.what());
+      return 1;
+    }
+  }
+
+  std::uint64_t uncovered{0};
+  std::uint64_t samples{0};
+  for (const auto count : merged.samples()) {
+    uncovered += count == 0 ? 1 : 0;
+    samples += count;
+  }
+  if (uncovered > 0) {
+    std::println(stderr, "[merge]: {} of {} pixels have no samples and stay black.", uncovered,
+                 merged.samples().size());
+  }
+
+  const auto format = image_path.ends_with(".pfm") ? rt::image_format::kPFM
+                                                   : rt::image_format::kPPMBinary;
+  try {
+    rt::write_image(image_path, format, merged.width(), merged.height(), merged.resolve());
+  } catch (const std::runtime_error& e) {
+    std::println(stderr, "{}", e.what());
+    return 1;
+  }
+  if (!film_path.empty() && !merged.save(film_path, scene_hash)) {
+    std::println(stderr, "{}: cannot write film", film_path);
+    return 1;
+  }
+  std::println("[merge]: {} partials, {} samples, written to {}.", partials.size(), samples,
+               image_path);
+  return 0;
+}
@@ -0,0 +1,250 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "include/bvh.h"
+#include "include/camera.h"
+#include "include/image.h"
+#include "include/scene.h"
+#include "include/scenes.h"
+
+namespace rt = raytracer;
+
+// the references committed with the source, cmake points this at them
+#ifndef RAYTRACER_REFERENCE_DIR
+#define RAYTRACER_REFERENCE_DIR "scene_bench/references"
+#endif
+
+namespace {
+
+// a reference scene at the size the suite renders it
+struct bench_scene {
+  std::string_view name_{};                    // NOLINT
+  std::function<rt::scene_preset()> build_{};  // NOLINT
+  int image_width_{};                          // NOLINT
+  int samples_per_pixel_{};                    // NOLINT
+};
+
+const std::vector<bench_scene>& bench_scenes() {
+  static const std::vector<bench_scene> kScenes{
+      {"random_spheres", [] { return rt::scenes::random_spheres(); }, 800, 64},
+      {"dense_glass", [] { return rt::scenes::dense_glass(); }, 640, 64},
+      {"many_spheres", [] { return rt::scenes::many_spheres(); }, 640, 32},
+      {"deep_bounce", [] { return rt::scenes::deep_bounce(); }, 320, 16},
+  };
+  return kScenes;
+}
+
+// render one scene and describe the run as the fields of a json object
+// runs in a process of its own, so peak memory is that of this scene alone
+std::string run_scene(const bench_scene& s, const std::string& image_path) {
+  using clock = std::chrono::steady_clock;
+  const auto seconds = [](const clock::time_point start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+  auto scene = s.build_();
+  scene.opts_.image_width_ = s.image_width_;
+  scene.opts_.samples_per_pixel_ = s.samples_per_pixel_;
+  scene.opts_.output_path_ = image_path;
+
+  const auto build_start = clock::now();
+  const rt::bvh_node bvh{scene.world_};
+  const auto build_seconds = seconds(build_start);
+
+  rt::camera camera{scene.opts_};
+  const auto render_start = clock::now();
+  camera.render(bvh);
+  const auto render_seconds = seconds(render_start);
+
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  const auto width = scene.opts_.image_width_;
+  const auto height = static_cast<int>(width / scene.opts_.aspect_ratio_);
+  const auto samples =
+      static_cast<double>(width) * height * static_cast<double>(scene.opts_.samples_per_pixel_);
+  const auto rays = static_cast<double>(camera.stats().segments_);
+  return std::format(
+      "\"width\": {}, \"height\": {}, \"samples_per_pixel\": {}, \"objects\": {}, "
+      "\"build_seconds\": {:.4f}, \"render_seconds\": {:.4f}, \"first_tile_seconds\": {:.4f}, "
+      "\"rays\": {}, \"mrays_per_second\": {:.3f}, \"samples_per_second\": {:.0f}, "
+      "\"average_path_length\": {:.3f}, \"peak_rss_mb\": {:.1f}",
+      width, height, scene.opts_.samples_per_pixel_, scene.world_.objects().size(),
+      build_seconds, render_seconds, camera.first_tile_seconds(), camera.stats().segments_,
+      rays / render_seconds * 1e-6, samples / render_seconds, camera.stats().average_length(),
+      static_cast<double>(usage.ru_maxrss) / 1024.0);
+}
+
+// run_scene in a child process, the parent never starts a render thread of its own
+// nullopt when the child fails
+std::optional<std::string> run_isolated(const bench_scene& s, const std::string& image_path) {
+  std::array<int, 2> fds{};
+  if (::pipe(fds.data()) != 0) {
+    return std::nullopt;
+  }
+  const auto pid = ::fork();
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return std::nullopt;
+  }
+  if (pid == 0) {
+    ::close(fds[0]);
+    const auto fields = run_scene(s, image_path);
+    const auto written = ::write(fds[1], fields.data(), fields.size());
+    ::_exit(written == static_cast<ssize_t>(fields.size()) ? 0 : 1);
+  }
+  ::close(fds[1]);
+  std::string fields{};
+  std::array<char, 4096> buf{};
+  ssize_t n{};
+  while ((n = ::read(fds[0], buf.data(), buf.size())) > 0) {
+    fields.append(buf.data(), static_cast<std::size_t>(n));
+  }
+  ::close(fds[0]);
+  int status{};
+  ::waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || fields.empty()) {
+    return std::nullopt;
+  }
+  return fields;
+}
+
+// difference of two images in gamma corrected values in [0, 1]
+struct image_diff {
+  double rmse_{};  // NOLINT
+  double mean_{};  // NOLINT signed, catches a uniform shift that rmse hides in noise
+};
+
+std::optional<image_diff> compare(const rt::ppm_image& a, const rt::ppm_image& b) {
+  if (a.width_ != b.width_ || a.height_ != b.height_) {
+    return std::nullopt;
+  }
+  double sum{0};
+  double sum_sq{0};
+  for (std::size_t k = 0; k < a.rgb_.size(); k++) {
+    const auto d = (static_cast<double>(a.rgb_[k]) - static_cast<double>(b.rgb_[k])) / 255.0;
+    sum += d;
+    sum_sq += d * d;
+  }
+  const auto n = static_cast<double>(a.rgb_.size());
+  return image_diff{.rmse_ = std::sqrt(sum_sq / n), .mean_ = sum / n};
+}
+
+}  // namespace
+
+// usage: raytracer_scene_bench [--scene name] [--out dir] [--references dir]
+//                              [--update-references] [--allow-missing-references]
+//                              [--tolerance rmse] [--bias mean]
+// renders the reference scenes at fixed seeds, each in a process of its own, and reports
+// throughput, time to the first tile and peak memory to <out>/scenes.json. every image is
+// compared against <references>/<scene>.ppm, by default the ones committed in
+// scene_bench/references of the source tree, and the run fails when one differs by more than
+// the rmse tolerance or is brighter or darker on average by more than the bias.
+// a scene without a reference fails too, so a run cannot pass without comparing anything,
+// unless --allow-missing-references is given. --update-references stores this run's images as
+// the new references
+int main(int argc, char* argv[]) {
+  std::string only{};
+  std::filesystem::path out_dir{"scene_bench"};
+  std::filesystem::path reference_dir{RAYTRACER_REFERENCE_DIR};
+  bool update{false};
+  bool allow_missing{false};
+  double tolerance{0.01};
+  double bias{0.002};
+  for (int a = 1; a < argc; a++) {
+    const std::string_view arg{argv[a]};
+    const bool has_value = a + 1 < argc;
+    bool ok{true};
+    if (arg == "--update-references") {
+      update = true;
+    } else if (arg == "--allow-missing-references") {
+      allow_missing = true;
+    } else if (arg == "--scene" && has_value) {
+      only = argv[++a];
+    } else if (arg == "--out" && has_value) {
+      out_dir = argv[++a];
+    } else if (arg == "--references" && has_value) {
+      reference_dir = argv[++a];
+    } else if (arg == "--tolerance" && has_value) {
+      ok = rt::parse_double(argv[++a], tolerance);
+    } else if (arg == "--bias" && has_value) {
+      ok = rt::parse_double(argv[++a], bias);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::println(stderr, "raytracer_scene_bench: bad argument {}", arg);
+      return 1;
+    }
+  }
+
+  std::error_code ec{};
+  std::filesystem::create_directories(out_dir, ec);
+  std::filesystem::create_directories(reference_dir, ec);
+  std::string json{"{\n  \"scenes\": ["};
+  bool first{true};
+  bool failed{false};
+  for (const auto& s : bench_scenes()) {
+    if (!only.empty() && s.name_ != only) {
+      continue;
+    }
+    const auto image_path = (out_dir / std::format("{}.ppm", s.name_)).string();
+    const auto reference_path = (reference_dir / std::format("{}.ppm", s.name_)).string();
+    const auto fields = run_isolated(s, image_path);
+    if (!fields) {
+      std::println(stderr, "[scene bench]: {} failed to render", s.name_);
+      failed = true;
+      continue;
+    }
+
+    std::string status{"no_reference"};
+    std::optional<image_diff> diff{};
+    const auto image = rt::read_ppm(image_path);
+    if (update && image) {
+      std::filesystem::copy_file(image_path, reference_path,
+                                 std::filesystem::copy_options::overwrite_existing, ec);
+      status = ec ? "update_failed" : "updated";
+    } else if (const auto reference = rt::read_ppm(reference_path); image && reference) {
+      diff = compare(*image, *reference);
+      status = diff && diff->rmse_ <= tolerance && std::abs(diff->mean_) <= bias ? "pass" : "fail";
+    }
+    failed = failed || status == "fail" || status == "update_failed" || !image ||
+             (status == "no_reference" && !allow_missing);
+
+    json += std::format("{}\n    {{\"name\": \"{}\", {}, \"image\": \"{}\", \"regression\": \"{}\"",
+                        first ? "" : ",", s.name_, *fields, image_path, status);
+    if (diff) {
+      json += std::format(", \"rmse\": {:.6f}, \"mean_difference\": {:.6f}", diff->rmse_,
+                          diff->mean_);
+    }
+    json += "}";
+    first = false;
+    std::println("[scene bench]: {}: {}", s.name_, status);
+  }
+  json += "\n  ]\n}\n";
+
+  const auto json_path = (out_dir / "scenes.json").string();
+  std::ofstream ofs(json_path, std::ios::trunc);
+  ofs << json;
+  if (!ofs) {
+    std::println(stderr, "raytracer_scene_bench: cannot write {}", json_path);
+    return 1;
+  }
+  std::println("[scene bench]: results written to {}", json_path);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/camera.h"
+#include "include/instance.h"
+#include "include/material.h"
+#include "include/rt.h"
+#include "include/scene.h"
+#include "include/sequence.h"
+#include "include/sphere.h"
+#include "include/transform.h"
+
+namespace rt = raytracer;
+
+namespace {
+
+// a sphere circling the origin
+struct orbit {
+  double radius_{};  // NOLINT of the circle
+  double height_{};  // NOLINT of the sphere's center above the ground
+  double phase_{};   // NOLINT degrees at frame 0
+  double speed_{};   // NOLINT degrees per frame
+  double size_{};    // NOLINT radius of the sphere
+};
+
+rt::transform place(const orbit& o, const int frame) {
+  const auto angle = rt::degrees2radians(o.phase_ + (o.speed_ * frame));
+  const rt::vec3 center{static_cast<rt::real>(o.radius_ * std::cos(angle)),
+                        static_cast<rt::real>(o.height_),
+                        static_cast<rt::real>(o.radius_ * std::sin(angle))};
+  return rt::transform::translate(center) * rt::transform::scale(static_cast<rt::real>(o.size_));
+}
+
+}  // namespace
+
+// usage: raytracer_sequence [--frames n] [--width px] [--samples n] [--out prefix]
+// renders an animation of spheres orbiting at different speeds while the camera circles them,
+// to <prefix>0000.ppm and on. the scene is built once, the instance bvh is refit every frame
+// and rebuilt only when the spheres have drifted far from their neighbours in the tree
+int main(int argc, char* argv[]) {
+  int frames{48};
+  int width{480};
+  int samples{16};
+  std::string prefix{"frame"};
+  for (int a = 1; a < argc; a++) {
+    const std::string_view arg{argv[a]};
+    const bool has_value = a + 1 < argc;
+    bool ok{true};
+    if (arg == "--frames" && has_value) {
+      ok = rt::parse_int(argv[++a], frames);
+    } else if (arg == "--width" && has_value) {
+      ok = rt::parse_int(argv[++a], width);
+    } else if (arg == "--samples" && has_value) {
+      ok = rt::parse_int(argv[++a], samples);
+    } else if (arg == "--out" && has_value) {
+      prefix = argv[++a];
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::println(stderr, "raytracer_sequence: bad argument {}", arg);
+      return 1;
+    }
+  }
+
+  rt::thread_rng() = rt::pcg32{4, 0};
+  const auto unit = std::make_shared<const rt::sphere>(
+      rt::point3{0, 0, 0}, 1, std::make_shared<rt::lambertian>(rt::color{0.5, 0.5, 0.5}));
+  std::vector<rt::instance> instances{};
+  // the ground stays put, it is instance 0
+  instances.emplace_back(unit,
+                         rt::transform::translate(rt::vec3{0, -1000, 0}) *
+                             rt::transform::scale(1000));
+  std::vector<orbit> orbits{};
+  for (int n = 0; n < 400; n++) {
+    const auto size = rt::random_double(0.1, 0.3);
+    orbits.push_back(orbit{.radius_ = rt::random_double(1, 8),
+                           .height_ = size,
+                           .phase_ = rt::random_double(0, 360),
+                           .speed_ = rt::random_double(-6, 6),
+                           .size_ = size});
+    const auto pick = rt::random_double();
+    const auto mat = pick < 0.6 ? std::shared_ptr<rt::material>{std::make_shared<rt::lambertian>(
+                                      rt::color::random(0.2, 0.9))}
+                     : pick < 0.85 ? std::shared_ptr<rt::material>{std::make_shared<rt::metal>(
+                                         rt::color::random(0.5, 1), 0.1)}
+                                   : std::shared_ptr<rt::material>{
+                                         std::make_shared<rt::dielectric>(1.5)};
+    instances.emplace_back(unit, place(orbits.back(), 0), mat);
+  }
+  rt::instance_bvh world{std::move(instances)};
+
+  rt::sequence_renderer sequence{world};
+  for (int f = 0; f < frames; f++) {
+    rt::frame_update frame{};
+    auto& opts = frame.opts_;
+    opts.image_width_ = width;
+    opts.samples_per_pixel_ = samples;
+    opts.max_depth_ = 20;
+    opts.vfov_ = 40;
+    const auto angle = rt::degrees2radians(f * 2.0);
+    opts.lookfrom_ = rt::vec3{static_cast<rt::real>(16 * std::cos(angle)), 5,
+                              static_cast<rt::real>(16 * std::sin(angle))};
+    opts.lookat_ = rt::vec3{0, 0.5, 0};
+    opts.output_path_ = std::format("{}{:04}.ppm", prefix, f);
+    if (f > 0) {
+      for (std::size_t n = 0; n < orbits.size(); n++) {
+        frame.transforms_.emplace_back(n + 1, place(orbits[n], f));
+      }
+    }
+    sequence.render(frame);
+  }
+  sequence.finish();
+  std::println("[sequence]: {} frames, the bvh was rebuilt for {} of them.", sequence.frames(),
+               sequence.rebuilds());
+  return sequence.failed_frames() > 0 ? 1 : 0;
+}
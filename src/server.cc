@@ -0,0 +1,102 @@
+#include <exception>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+
+#include "include/bvh.h"
+#include "include/camera.h"
+#include "include/scene_cache.h"
+#include "include/scenes.h"
+#include "include/server.h"
+
+namespace rt = raytracer;
+
+namespace {
+
+// send one request and print the replies until the server closes the connection
+// 0 if the last reply reports success
+int send_request(const std::string& socket, const std::string& request) {
+  auto conn = rt::connection::open(socket);
+  if (!conn.write_line(request)) {
+    std::println(stderr, "raytracer_server: the server closed the connection");
+    return 1;
+  }
+  std::string last{};
+  while (const auto reply = conn.read_line()) {
+    std::println("{}", *reply);
+    last = *reply;
+  }
+  return last.starts_with("done") || last.starts_with("cancelling") || last == "ok" ? 0 : 1;
+}
+
+// the render request for the --priority and --<option> <values...> arguments in
+// argv[first, argc), as option lines of a scene file
+std::string render_request(const int first, const int argc, char* argv[]) {
+  std::string priority{"0"};
+  std::string options{};
+  for (int a = first; a < argc;) {
+    const std::string_view flag{argv[a]};
+    std::string values{};
+    for (a++; a < argc && !std::string_view{argv[a]}.starts_with("--"); a++) {
+      values += ' ';
+      values += argv[a];
+    }
+    if (flag == "--priority") {
+      priority = values.empty() ? priority : values.substr(1);
+    } else {
+      // bad flags are reported by the server
+      options += std::format("option {}{}\n", flag.substr(flag.starts_with("--") ? 2 : 0), values);
+    }
+  }
+  return std::format("render {}\n{}end", priority, options);
+}
+
+}  // namespace
+
+// usage:
+//   raytracer_server serve <socket> [scene]
+//   raytracer_server render <socket> [--priority <n>] [--<option> <values...>]...
+//   raytracer_server cancel <socket> <id>
+//   raytracer_server shutdown <socket>
+// serve loads the scene once, or builds the built-in one, and renders the jobs sent to the unix
+// domain socket until it is shut down. the other commands are its client: render queues a job
+// with the scene's options changed as on the raytracer command line and waits for it, printing
+// its id and then its timings, cancel and shutdown act on a running server
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::println(stderr, "usage: raytracer_server serve|render|cancel|shutdown <socket> ...");
+    return 1;
+  }
+  const std::string_view command{argv[1]};
+  const std::string socket{argv[2]};
+  try {
+    if (command == "serve") {
+      if (argc > 3) {
+        const auto scene = rt::mapped_scene::open(argv[3]);
+        rt::render_server server{*scene, scene->scene_options()};
+        server.serve(socket);
+        return 0;
+      }
+      auto scene = rt::scenes::random_spheres();
+      const rt::bvh_node bvh{scene.world_};
+      rt::render_server server{bvh, scene.opts_};
+      server.serve(socket);
+      return 0;
+    }
+    if (command == "render") {
+      return send_request(socket, render_request(3, argc, argv));
+    }
+    if (command == "cancel" && argc > 3) {
+      return send_request(socket, std::format("cancel {}", argv[3]));
+    }
+    if (command == "shutdown") {
+      return send_request(socket, "shutdown");
+    }
+  } catch (const std::exception& e) {
+    std::println(stderr, "{}", e.what());
+    return 1;
+  }
+  std::println(stderr, "raytracer_server: unknown command '{}'", command);
+  return 1;
+}